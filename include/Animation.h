@@ -0,0 +1,60 @@
+/*
+  Animation.h
+
+  Keyframe animations for the 4 digit display. An animation is a table of keyframes in PROGMEM, each one
+  draws some digits and says how long it stays. The Animator draws one keyframe per step() and returns
+  the hold time, the scheduler calls it again when that is over, so nothing blocks in between.
+
+  A keyframe either
+  - draws its segments into the digits selected by its digit mask (other digits keep what they show,
+    mask 0 only waits), or
+  - has an action: then the renderer given to the Animator draws it, for content only known at run
+    time (a height, the selected position).
+  The keyframe with hold 0 is the last one, what it draws stays on the display.
+
+  Every animation has a priority. play() refuses an animation while one with a higher priority is
+  still running, so e.g. an error message isn't cut short by the height display. stop() always ends it.
+*/
+#ifndef Animation_h
+#define Animation_h
+
+#include <Arduino.h>
+#include <TM1637Display.h>
+
+#define ANIMATION_DIGITS 0x0F //digit mask of all four digits
+
+struct Keyframe {
+  TM1637Text text;  //segments of the four digits
+  uint8_t digits;   //bit n: the keyframe draws digit n
+  uint8_t action;   //0 = draw the segments, else handed to the renderer
+  uint16_t hold;    //ms, 0 = last keyframe
+};
+
+struct Animation {
+  const Keyframe* frames; //PROGMEM
+  uint8_t priority;
+};
+
+typedef void (*AnimationRenderer)(uint8_t action);
+
+class Animator {
+  public:
+    Animator(TM1637Display &display, AnimationRenderer renderer) : display(display), renderer(renderer) {}
+
+    //Starts animation (in PROGMEM) from its first keyframe, unless one with a higher priority is running.
+    //Returns whether it was started
+    bool play(const Animation* animation);
+    void stop() { current = NULL; }
+    bool playing() { return current != NULL; }
+
+    //Draws the next keyframe and returns how long it holds (ms), 0 once the animation is over
+    unsigned long step();
+
+  private:
+    TM1637Display &display;
+    AnimationRenderer renderer;
+    const Keyframe* current = NULL; //next keyframe, NULL while nothing plays
+    uint8_t priority = 0;
+};
+
+#endif // Animation_h
@@ -0,0 +1,41 @@
+/*
+  HeightFusion.h
+
+  Combines the two height sources of the desk:
+  - the sonar: absolute, but only every SONAR_INTERVAL and with about +-2 mm of noise and 1 cm steps
+  - the motor encoders: relative, but counted by interrupt with a resolution of about 2 um
+  Between two sonar readings the height follows the encoder counts. Every sonar reading pulls the
+  encoder offset 1/FUSION_GAIN of the way towards it (complementary filter), so noise averages out
+  and a slipping or missing encoder can't drift away. A disagreement of more than REANCHOR_DISTANCE
+  snaps the offset to the sonar. If the desk got that far without a single count the encoders are
+  considered lost, the height is the plain sonar reading until they count again.
+*/
+#ifndef HeightFusion_h
+#define HeightFusion_h
+
+#include <Arduino.h>
+
+#define FUSION_GAIN 8
+#define REANCHOR_DISTANCE 20000L //um
+
+class HeightFusion {
+  public:
+    //countsPerCm: encoder counts per cm of desk travel
+    HeightFusion(long countsPerCm) : countsPerCm(countsPerCm) {}
+
+    //New sonar reading in um, 0 (sonar error) is ignored
+    void sonar(long heightUm, long counts);
+    //Fused height in um for the current encoder counts, 0 until the first sonar reading
+    long height(long counts);
+    bool encodersWorking() { return !encodersLost; }
+
+  private:
+    long countsPerCm;
+    long offset = 0; //height at 0 counts, um
+    bool anchored = false;
+    bool encodersLost = false;
+    long lastCounts = 0;
+    long lastSonar = 0;
+};
+
+#endif // HeightFusion_h
@@ -0,0 +1,60 @@
+/*
+  HeightKalman.h
+
+  Estimates height and velocity of the desk with a 1-D constant velocity Kalman filter in fixed point
+  (no float on the AVR).
+  - predict() runs at the control tick and moves the estimate along. The commanded duty is the control
+    input: the velocity follows duty * speed per duty with the time constant KALMAN_TAU. The speed per
+    duty of each direction is learned while the desk cruises, so load and gravity are accounted for.
+  - update() corrects the estimate with a height measurement (a sonar reading or the fused encoder
+    height), weighted by how much the prediction and the measurement are trusted.
+
+  The state is in um and um/s. The covariances are kept in units of KALMAN_UNIT um so the products fit,
+  intermediate products are 64 bit.
+*/
+#ifndef HeightKalman_h
+#define HeightKalman_h
+
+#include <Arduino.h>
+#include "Motor.h"
+
+#define KALMAN_UNIT 10              //um, unit of the covariances
+#define KALMAN_TAU 100              //ms, time constant of the desk speed following the duty
+#define KALMAN_HEIGHT_NOISE 100L    //process noise of the height, units per sqrt(s)
+#define KALMAN_VELOCITY_NOISE 500L  //process noise of the velocity, units/s per sqrt(s)
+#define KALMAN_START_SPEED 30000L   //um/s at full duty until it is learned
+#define KALMAN_LEARN_DUTY 512       //the speed per duty is learned above this duty
+
+class HeightKalman {
+  public:
+    //measurementNoise: standard deviation of a measurement in um
+    HeightKalman(long measurementNoise);
+
+    //Moves the estimate along to now (ms) with the duty the motors run at (signed, positive = up)
+    void predict(int duty, unsigned long now);
+    //Corrects the estimate with a height measured at now, in um
+    void update(long heightUm, unsigned long now);
+    //Forgets the estimate, the next measurement starts it over
+    void reset() { started = false; }
+
+    //Height in um, 0 until the first measurement
+    long height() { return started ? h : 0; }
+    //Velocity in um/s, positive = up
+    long velocity() { return started ? v : 0; }
+
+  private:
+    long r;               //measurement variance, units^2
+    bool started = false;
+    unsigned long at = 0; //ms the estimate is for
+    int duty = 0;
+    long h = 0;           //um
+    long v = 0;           //um/s
+    long speedUp = KALMAN_START_SPEED;   //um/s at full duty
+    long speedDown = KALMAN_START_SPEED;
+    //Covariance, in units^2, units^2/s and units^2/s^2
+    long p00 = 0;
+    long p01 = 0;
+    long p11 = 0;
+};
+
+#endif // HeightKalman_h
@@ -0,0 +1,102 @@
+/*
+  Motion.h
+
+  State machine driving the desk to a target height (the auto-drive programs). Heights are in mm,
+  velocities in mm/s. step() is called once per loop() with the latest estimate and advances the machine by at most one
+  transition, so a cancel is never more than one loop() away. Each state is one row in a handler table:
+
+    IDLE      nothing to do
+    RAMP_UP   motors spin up to full speed (the ramp itself is done by the motor profile)
+    CRUISE    full speed until the target is within APPROACH_DISTANCE
+    APPROACH  closed loop: a PID controller drives the desk into the deadband around the target,
+              in either direction. The motors are stopped once the desk would come to rest within it
+    SETTLE    motors ramp down, wait for the desk to come to rest. If it came to rest outside the
+              deadband the controller gets another go (up to MAX_CORRECTIONS times, none after
+              APPROACH_TIMEOUT). If it is still outside then, the program missed its target
+    FAULT     motors off at once after a sonar error, also one while settling
+
+  The desk keeps going for a bit after the motors are told to stop (ramp down, inertia). Motion stops
+  them early at target - predicted coast, the coast being the velocity times a coast time per direction.
+  After every stop the coast time is measured from where the desk came to rest and the model follows
+  it by 1/COAST_LEARN_RATE, so it keeps up with the load. The owner persists it (see StoredCoast).
+*/
+#ifndef Motion_h
+#define Motion_h
+
+#include <Arduino.h>
+#include "PidController.h"
+
+enum MotionState : uint8_t {
+  MOTION_IDLE,
+  MOTION_RAMP_UP,
+  MOTION_CRUISE,
+  MOTION_APPROACH,
+  MOTION_SETTLE,
+  MOTION_FAULT,
+  MOTION_STATE_COUNT
+};
+
+enum MotionResult : uint8_t {
+  MOTION_REACHED,
+  MOTION_CANCELLED,
+  MOTION_FAILED,
+  MOTION_MISSED     //came to rest outside the deadband: the approach timed out or the corrections ran out
+};
+
+typedef void (*MotionCallback)(MotionResult result);
+
+class Motion {
+  public:
+    Motion();
+    //finished is called once for every program that was started
+    void begin(MotionCallback finished);
+    //Starts driving to target. Returns false (and doesn't move) if the height is unknown or the desk is there already
+    bool start(int target, int height);
+    void cancel();
+    void step(int height, int velocity);
+
+    bool active() { return current != MOTION_IDLE; }
+    MotionState state() { return current; }
+    int target() { return targetHeight; }
+    int8_t direction() { return dir; }
+
+    //Coast time in ms per direction (1 = up, -1 = down), learned after every stop of a program
+    int coastTime(int8_t direction) { return direction > 0 ? coastUp : coastDown; }
+    void setCoastTime(int8_t direction, int ms);
+
+  private:
+    typedef MotionState (Motion::*Handler)(int height);
+    static const Handler handlers[MOTION_STATE_COUNT];
+
+    MotionState idle(int height);
+    MotionState rampUp(int height);
+    MotionState cruise(int height);
+    MotionState approach(int height);
+    MotionState settle(int height);
+    MotionState fault(int height);
+
+    void drive(int pwm);
+    void learnCoast(int height);
+    int remaining(int height);
+    int error(int height);
+    int fullDuty();
+    MotionState startControl();
+    unsigned long inState() { return millis() - enteredAt; }
+
+    MotionState current = MOTION_IDLE;
+    MotionCallback callback = NULL;
+    int targetHeight = 0;
+    int8_t dir = 0; //1 = up, -1 = down
+    int speed = 0;  //mm/s, signed, as passed to step()
+    PidController pid;
+    unsigned long controlledAt;
+    uint8_t corrections = 0;
+    bool missed = false;
+    int coastUp;
+    int coastDown;
+    int stopHeight = 0; //where the motors were stopped, mm
+    int stopSpeed = 0;  //and how fast the desk went then, mm/s. 0: nothing to learn from
+    unsigned long enteredAt;
+};
+
+#endif // Motion_h
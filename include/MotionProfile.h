@@ -0,0 +1,42 @@
+/*
+  MotionProfile.h
+
+  Ramps the motor duty cycle towards a requested value instead of jumping there, S-curve style:
+  the duty changes by at most `accel` per second and that rate itself changes by at most `jerk` per
+  second², so neither the current nor the force on the spindle couplings jump. Ramping towards a new
+  value always brakes the rate in time to land on it without overshooting.
+
+  The duty is signed (positive = up). On its way from one direction to the other the output always
+  stops at 0 for one tick, so the bridge is never reversed under load.
+  Integer math only, update() is meant to be called from a periodic scheduler task.
+*/
+#ifndef MotionProfile_h
+#define MotionProfile_h
+
+#include <Arduino.h>
+
+class MotionProfile {
+  public:
+    //accel in duty/s, jerk in duty/s²
+    MotionProfile(unsigned int accel, unsigned int jerk) : accel(accel), jerk(jerk) {}
+
+    void setTarget(int duty) { goal = duty; }
+    //Output to 0 immediately, for emergencies
+    void halt();
+    //Advances the profile by dtMs and returns the new output duty
+    int update(unsigned int dtMs);
+
+    int output() { return out; }
+    int target() { return goal; }
+    bool settled() { return out == goal && rate == 0; }
+
+  private:
+    unsigned int accel;
+    unsigned int jerk;
+    int goal = 0;
+    int out = 0;
+    long position = 0; //output in 1/1000 duty
+    long rate = 0;     //duty/s
+};
+
+#endif // MotionProfile_h
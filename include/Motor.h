@@ -0,0 +1,26 @@
+/*
+  Motor.h
+
+  The motor functions of the desk (implemented in main.cpp), shared with the motion state machine.
+*/
+#ifndef Motor_h
+#define Motor_h
+
+#include <Arduino.h>
+#include <MotorPwm.h>
+
+#define MOTOR_DUTY_MAX MOTOR_PWM_MAX //full duty, the duties are 10 bit
+
+extern const int PWM_SPEED_UP;
+extern const int PWM_SPEED_DOWN;
+
+//Set the duty the motors ramp to, stopMoving() ramps them down
+void goUp(int pwm = PWM_SPEED_UP);
+void goDown(int pwm = PWM_SPEED_DOWN);
+void stopMoving();
+//Motors off without ramp
+void haltMotors();
+//Duty applied to the motors right now, positive = up
+int motorDuty();
+
+#endif // Motor_h
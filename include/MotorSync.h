@@ -0,0 +1,43 @@
+/*
+  MotorSync.h
+
+  Both motors turn the same allen shaft, so whichever is a little stronger does most of the work and
+  the other one rides along or even brakes it. MotorSync shares the load evenly: motor A is the master
+  and runs at the requested duty, motor B (the slave) gets a trim on top that an integral loop adjusts
+  until both draw the same current. When the trimmed duty of B doesn't fit below full duty the excess is
+  taken off A instead, so full speed still balances.
+
+  The currents come from the sense outputs of the L298N (see USE_CURRENT_SENSE in include/Pins.h),
+  only their difference matters, so they are used as raw ADC counts.
+*/
+#ifndef MotorSync_h
+#define MotorSync_h
+
+#include <Arduino.h>
+#include "Motor.h"
+
+#define SYNC_MAX_TRIM 240  //duty
+#define SYNC_GAIN 16       //trim change per update and ADC count of current difference, in 1/64
+#define SYNC_FILTER 4      //the currents are averaged over about 2^SYNC_FILTER updates
+
+class MotorSync {
+  public:
+    //Forget the trim, e.g. when the motors stop
+    void reset();
+    //Adjusts the trim from the currents of both channels, call it periodically while the motors run
+    void update(int currentA, int currentB);
+    //Splits a signed duty into the duties of both channels
+    void split(int duty, int &dutyA, int &dutyB);
+
+    int trim() { return trimValue / 64; }
+    int currentA() { return filteredA >> SYNC_FILTER; }
+    int currentB() { return filteredB >> SYNC_FILTER; }
+
+  private:
+    long trimValue = 0; //duty * 64
+    long filteredA = 0; //current << SYNC_FILTER
+    long filteredB = 0;
+    bool primed = false;
+};
+
+#endif // MotorSync_h
@@ -0,0 +1,38 @@
+/*
+  PidController.h
+
+  Integer PID controller. Gains are given in 1/PID_SCALE output units, e.g. kp = 250 means 2.5 output
+  units (PWM duty) per unit of error.
+  - The derivative acts on the rate of the measurement, not on the error, so a new setpoint doesn't kick
+    the output. The caller passes the rate in, e.g. the velocity of an estimator, differencing a
+    quantized measurement would mostly give noise.
+  - Anti-windup: the integral is clamped to what the output limit can use, and it stops growing while
+    the output is saturated in the direction of the error.
+*/
+#ifndef PidController_h
+#define PidController_h
+
+#include <Arduino.h>
+
+#define PID_SCALE 100
+
+class PidController {
+  public:
+    PidController(int kp, int ki, int kd, int limit);
+
+    //Forgets the integral
+    void reset();
+    //error = setpoint - measurement, rate = change of the measurement per second.
+    //Returns the output, clamped to +-limit
+    int update(long error, long rate, unsigned int dtMs);
+
+  private:
+    int kp;
+    int ki;
+    int kd;
+    int limit;
+    long integral = 0;   //error * ms
+    long integralMax;
+};
+
+#endif // PidController_h
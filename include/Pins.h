@@ -0,0 +1,40 @@
+/*
+  Pins.h
+
+  Wiring of the desk controller, see wiring/MotorControlWithSonar.jpg
+*/
+#ifndef Pins_h
+#define Pins_h
+
+#define BUTTON_UP 2
+#define BUTTON_DOWN 3
+#define BUTTON_POS_0 4
+#define BUTTON_POS_1 5
+#define enA 9           // OC1A, the enables get 20 kHz PWM from Timer1 (see MotorPwm.h)
+#define in1 7
+#define in2 8
+#define enB 10          // OC1B
+#define in3 11
+#define in4 12
+#define CLK 14          // 7 Segment
+#define DIO 15          // 7 Segment
+#define ECHO_PIN 16     // Arduino pin tied to echo pin on the ultrasonic sensor
+#define TRIGGER_PIN 17  // Arduino pin tied to trigger pin on the ultrasonic sensor
+// TEMPERATURE_PIN      // optional TMP36 for the speed of sound, set with -D TEMPERATURE_PIN=A6 (see Thermometer.h)
+
+#ifdef USE_ENCODERS     // Hall encoders of the gearmotors, channels A and B of each
+#define ENCODER_A1 18   // Motor A
+#define ENCODER_A2 19
+#define ENCODER_B1 6    // Motor B
+#define ENCODER_B2 13   // LED_BUILTIN, the LED isn't used then
+#endif
+
+#ifdef USE_CURRENT_SENSE        // SENSE A/B of the L298N over 0.5 ohm to GND, RC filtered (1k, 10uF)
+#ifdef USE_ENCODERS
+#error "USE_CURRENT_SENSE and USE_ENCODERS both need pins 18 and 19"
+#endif
+#define CURRENT_SENSE_A A4
+#define CURRENT_SENSE_B A5
+#endif
+
+#endif // Pins_h
@@ -0,0 +1,67 @@
+/*
+  Profiler.h
+
+  Opt-in latency instrumentation for the control loop. Build with -D PROFILING (see platformio.ini) and
+  every stage wrapped in PROFILE_BEGIN()/PROFILE_END() is timed with micros(). Per stage the profiler
+  keeps min/max/mean and a histogram in RAM (no heap):
+
+    bucket   0    1    2     3     4     5      6       7
+    us     <16  <32  <64  <128  <256  <512  <1024  >=1024
+
+  Histogram counts stop at 65535, 'r' starts a new measurement.
+
+  PROFILE_POLL() in loop() listens on Serial: 'p' prints the table, 'r' resets it. The telemetry is
+  compiled out meanwhile (see Telemetry.h), the timings of the stages don't include building its frames.
+  Without PROFILING all macros compile to nothing, so they can stay in the production firmware.
+
+  micros() has a resolution of 4 us on a 16 MHz AVR and one BEGIN/END pair costs about 8 us itself.
+  Timer1 is not used, it is reserved for the motor PWM.
+*/
+#ifndef Profiler_h
+#define Profiler_h
+
+#include <Arduino.h>
+
+enum ProfileStage : uint8_t {
+  STAGE_LOOP,       //one whole loop()
+  STAGE_BUTTONS,    //debouncing the four buttons
+  STAGE_HANDLERS,   //button handlers (cancel, up/down, positions)
+  STAGE_SONAR,      //picking up the sonar reading
+  STAGE_MOTION,     //one step of the motion state machine
+  STAGE_TASKS,      //scheduler.run() including the tasks it executes
+  STAGE_DISPLAY,    //sending the changed digits to the TM1637
+  PROFILE_STAGE_COUNT
+};
+
+#define PROFILE_BUCKETS 8
+
+#ifdef PROFILING
+
+struct ProfileStats {
+  unsigned long startedAt;
+  unsigned long min;
+  unsigned long max;
+  unsigned long total;
+  unsigned long count;
+  uint16_t histogram[PROFILE_BUCKETS];
+};
+
+void profileBegin(ProfileStage stage);
+void profileEnd(ProfileStage stage);
+void profileReset();
+void profilePrint();
+void profilePoll();
+
+#define PROFILE_BEGIN(stage) profileBegin(stage)
+#define PROFILE_END(stage) profileEnd(stage)
+#define PROFILE_POLL() profilePoll()
+
+#else
+
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+#define PROFILE_POLL()
+
+#endif // PROFILING
+
+#endif // Profiler_h
@@ -0,0 +1,61 @@
+/*
+  QuadratureEncoder.h
+
+  Interrupt driven decoder for the hall encoders of the gearmotors (64 counts per motor revolution,
+  x4 decoding). Both channels fire a pin change interrupt, every valid Gray code step counts one up or
+  down, invalid steps (both channels changed, an edge was missed) are ignored.
+  The pins are fixed at compile time, the interrupt reads them through FastPin: at ~5333 counts/cm
+  it runs some 10000 times a second per motor while the desk moves, in the same pin change group
+  as the sonar echo.
+  The interrupt needs a plain function, so every encoder gets a small trampoline:
+
+    QuadratureEncoder<PIN_A, PIN_B> encoder;
+    void encoderChanged() { encoder.changed(); }
+    encoder.begin(encoderChanged);
+*/
+#ifndef QuadratureEncoder_h
+#define QuadratureEncoder_h
+
+#include <Arduino.h>
+#include <FastPin.h>
+#include <PinChange.h>
+
+//The decoding, independent of the pins
+class QuadratureDecoder {
+  public:
+    //Counts since begin(), positive when channel A leads
+    long count();
+
+  protected:
+    //Counts the step from the last state to next (A << 1 | B)
+    void step(uint8_t next) {
+      position += STEPS[(state << 2) | next];
+      state = next;
+    }
+
+    volatile uint8_t state = 0;
+    volatile long position = 0;
+
+  private:
+    static const int8_t STEPS[16];
+};
+
+template <uint8_t pinA, uint8_t pinB>
+class QuadratureEncoder : public QuadratureDecoder {
+  public:
+    void begin(PinChangeCallback isr) {
+      FastPin<pinA>::inputPullup();
+      FastPin<pinB>::inputPullup();
+      state = read();
+      attachPinChange(pinA, isr);
+      attachPinChange(pinB, isr);
+    }
+
+    //Interrupt handler, called on every edge of either channel
+    void changed() { step(read()); }
+
+  private:
+    static uint8_t read() { return FastPin<pinA>::read() << 1 | FastPin<pinB>::read(); }
+};
+
+#endif // QuadratureEncoder_h
@@ -0,0 +1,23 @@
+/*
+  ResetCause.h
+
+  Why the board started: the reset flags of MCUSR (bits PORF, EXTRF, BORF, WDRF).
+  Optiboot (the Uno bootloader) clears MCUSR before it starts the sketch and hands the flags over in r2
+  instead. They are saved from there before the C runtime starts; the flags read from MCUSR still win
+  if the bootloader left them. With neither, the cause is unknown and readResetCause() returns 0.
+  readResetCause() also clears MCUSR, so the next reset reports only its own cause. Call it once, early
+  in setup().
+*/
+#ifndef ResetCause_h
+#define ResetCause_h
+
+#include <Arduino.h>
+
+#define RESET_POWER_ON bit(PORF)
+#define RESET_EXTERNAL bit(EXTRF) //reset button, or the programmer at upload
+#define RESET_BROWN_OUT bit(BORF) //the supply sagged, e.g. when a motor stalled
+#define RESET_WATCHDOG bit(WDRF)
+
+uint8_t readResetCause();
+
+#endif // ResetCause_h
@@ -0,0 +1,42 @@
+/*
+  Scheduler.h
+
+  Minimal cooperative task scheduler for the desk controller.
+  Tasks live in a fixed table (no heap), each one with a millis() deadline. loop() calls run() as often as
+  it can and every task whose deadline has passed is executed once. A task with an interval repeats,
+  a task without one is a one-shot that can re-arm itself with runIn().
+  Tasks must never block: anything that used to be a delay() is expressed as "come back in x ms".
+*/
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 8
+#define TASK_NONE 0xFF
+
+typedef void (*TaskCallback)();
+
+class Scheduler {
+  public:
+    //Registers a task. A periodic task (interval > 0) is due immediately, a one-shot task stays idle until runIn()
+    uint8_t add(TaskCallback callback, unsigned long interval = 0);
+    //(Re)arms a task to run once delayMs from now. Periodic tasks continue with their interval afterwards
+    void runIn(uint8_t task, unsigned long delayMs);
+    void cancel(uint8_t task);
+    bool pending(uint8_t task);
+    //Executes every task that is due. Call this from loop()
+    void run();
+
+  private:
+    struct Task {
+      TaskCallback callback;
+      unsigned long interval;
+      unsigned long due;
+      bool active;
+    };
+    Task tasks[SCHEDULER_MAX_TASKS];
+    uint8_t count = 0;
+};
+
+#endif // Scheduler_h
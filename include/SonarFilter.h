@@ -0,0 +1,61 @@
+/*
+  SonarFilter.h
+
+  Filter stage between the sonar driver and the rest of the firmware. Every raw reading goes through
+  - a range check: the desk can't be lower or higher than minValue/maxValue (0 = no echo fails too)
+  - a jump check: the desk moves at most maxSpeed, a reading further away from the median of the
+    accepted ones than the desk could have travelled since (plus margin for the sensor noise) is an
+    outlier. Comparing with the median rather than the last reading keeps a spurious echo that just
+    slipped through from moving the reference away from the desk
+  - a median over the last SONAR_FILTER_SIZE accepted readings, kept in a fixed ring buffer
+  Errors are classified with hysteresis: only SONAR_ERROR_ENTER bad readings in a row make the sensor
+  count as failed, and it takes SONAR_ERROR_LEAVE consistent good ones to recover. A single spurious
+  echo or a missing one is simply dropped.
+
+  All values are in the unit of the readings.
+*/
+#ifndef SonarFilter_h
+#define SonarFilter_h
+
+#include <Arduino.h>
+
+#define SONAR_FILTER_SIZE 5   //readings the median is taken over, odd
+#define SONAR_ERROR_ENTER 5   //bad readings in a row before the sensor counts as failed
+#define SONAR_ERROR_LEAVE 3   //consistent good readings in a row to recover
+
+class SonarFilter {
+  public:
+    //maxSpeed in units per second
+    SonarFilter(unsigned int minValue, unsigned int maxValue, unsigned int maxSpeed, unsigned int margin);
+
+    //Adds the reading taken at now (ms). Returns true if it was accepted
+    bool add(unsigned int reading, unsigned long now);
+    //Median of the accepted readings, 0 while the sensor has failed or before the first reading
+    unsigned int value();
+    //Last accepted reading, without the delay of the median
+    unsigned int latest() { return failedState ? 0 : lastAccepted; }
+    bool failed() { return failedState; }
+    //Farthest reading add() would accept at now, maxValue while there is nothing to go by
+    unsigned int reach(unsigned long now);
+
+  private:
+    bool plausible(unsigned int reading, unsigned long now);
+    unsigned int median();
+    unsigned int reference();
+
+    unsigned int minValue;
+    unsigned int maxValue;
+    unsigned int maxSpeed;
+    unsigned int margin;
+
+    unsigned int samples[SONAR_FILTER_SIZE];
+    uint8_t head = 0;
+    uint8_t count = 0;
+    unsigned int lastAccepted = 0;
+    unsigned long acceptedAt = 0;
+    uint8_t badRun = 0;
+    uint8_t goodRun = 0;
+    bool failedState = false;
+};
+
+#endif // SonarFilter_h
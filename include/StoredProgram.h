@@ -0,0 +1,26 @@
+/*
+  StoredProgram.h
+
+  Layout of the settings persisted in EEPROM at EEPROM_ADDRESS.
+*/
+#ifndef StoredProgram_h
+#define StoredProgram_h
+
+//Struct to store the various necessary variables to persist the autoRaise/autoLower programs to EEPROM
+struct StoredProgram
+{
+  int pos0Height = 0; //height in mm above ground for the sitting position
+  int pos1Height = 0; //height in mm above ground for the standing position
+};
+
+#define STORED_COAST_VERSION 0xC1 //anything else at its address: nothing learned yet
+
+//Coast of the desk after the motors are stopped, learned by Motion, stored right after StoredProgram
+struct StoredCoast
+{
+  uint8_t version = STORED_COAST_VERSION;
+  int upTime = 0;   //ms the desk keeps going at its speed when stopped on the way up
+  int downTime = 0; //the same on the way down
+};
+
+#endif // StoredProgram_h
@@ -0,0 +1,91 @@
+/*
+  Telemetry.h
+
+  Binary telemetry for the serial port. Instead of text lines the firmware sends fixed size frames that
+  are queued in a ring buffer and handed to the UART only as far as its transmit buffer has room, so
+  the interrupt driven transmitter of HardwareSerial sends them in the background and loop() never
+  waits for the serial port. When the ring is full new frames are dropped and the next frame that makes
+  it carries TELEMETRY_FLAG_DROPPED. tools/telemetry.py decodes the stream on the PC.
+  Heights, also in the event values, are in mm.
+  Built with PROFILING no frames are sent: the profiler prints its statistics as text on the same port,
+  which would end up in the middle of a frame.
+
+  Frame, 16 bytes, little endian:
+    0  0xA5 0x5A  sync
+    2  uint8      event (TelemetryEvent)
+    3  uint32     millis()
+    7  int16      height as read by the sonar in mm, 0 = sonar error
+    9  int16      motor duty (10 bit), positive = up, negative = down
+   11  uint8      motion state (MotionState)
+   12  uint8      flags (TELEMETRY_FLAG_...)
+   13  int16      value, meaning depends on the event
+   15  uint8      checksum, sum of bytes 2..14
+*/
+#ifndef Telemetry_h
+#define Telemetry_h
+
+#include <Arduino.h>
+
+#define TELEMETRY_BUFFER 128 //bytes, power of two
+#define TELEMETRY_FRAME_SIZE 16
+#define TELEMETRY_SYNC_1 0xA5
+#define TELEMETRY_SYNC_2 0x5A
+
+#define TELEMETRY_FLAG_BUTTON_UP    0x01
+#define TELEMETRY_FLAG_BUTTON_DOWN  0x02
+#define TELEMETRY_FLAG_BUTTON_POS_0 0x04
+#define TELEMETRY_FLAG_BUTTON_POS_1 0x08
+#define TELEMETRY_FLAG_TRACKING     0x10 //the display follows the height
+#define TELEMETRY_FLAG_MANUAL       0x20 //desk is moved by BUTTON_UP/BUTTON_DOWN
+#define TELEMETRY_FLAG_POSITION_1   0x40 //position 1 was selected last (else position 0)
+#define TELEMETRY_FLAG_DROPPED      0x80 //frames were lost before this one
+
+//Keep in sync with tools/telemetry.py
+enum TelemetryEvent : uint8_t {
+  EVENT_SAMPLE,            //periodic sample while the desk moves, value: estimated velocity in mm/s
+  EVENT_BOOT,              //value: reset cause, MCUSR flags (see ResetCause.h)
+  EVENT_POSITION_0_LOADED, //value: height saved in EEPROM
+  EVENT_POSITION_1_LOADED, //value: height saved in EEPROM
+  EVENT_BUTTON_UP,
+  EVENT_BUTTON_DOWN,
+  EVENT_BUTTON_POSITION,
+  EVENT_BUTTON_RELEASED,
+  EVENT_BOTH_BUTTONS,      //up and down held together, motors stopped
+  EVENT_MOTOR_UP,          //value: PWM
+  EVENT_MOTOR_DOWN,        //value: PWM
+  EVENT_MOTOR_STOP,
+  EVENT_HEIGHT,            //value: new height shown on the display
+  EVENT_SONAR_ERROR,
+  EVENT_SAVED,             //value: saved height
+  EVENT_SAVE_REJECTED,     //value: height of the other position it conflicts with
+  EVENT_PROGRAM_START,     //value: target height
+  EVENT_PROGRAM_REFUSED,   //sonar error, program not started
+  EVENT_PROGRAM_REACHED,
+  EVENT_PROGRAM_CANCELLED,
+  EVENT_PROGRAM_FAILED,    //sonar error while driving
+  EVENT_SONAR_REJECTED,    //value: raw reading the sonar filter dropped
+  EVENT_COAST_SAVED,       //value: learned coast time in ms of the direction just driven, negative = down
+  EVENT_PROGRAM_MISSED,    //came to rest outside the deadband, value: mm still to go to the target
+  EVENT_COUNT
+};
+
+class Telemetry {
+  public:
+    //Queues a frame, drops it if the ring is full
+    void send(TelemetryEvent event, unsigned long time, int height, int pwm, uint8_t state, uint8_t flags, int value);
+    //Moves queued bytes into the UART transmit buffer as far as it has room. Call this from loop()
+    void drain();
+    unsigned int dropped() { return droppedFrames; }
+
+  private:
+    void put(uint8_t b);
+
+    uint8_t buffer[TELEMETRY_BUFFER];
+    uint8_t head = 0;
+    uint8_t tail = 0;
+    uint8_t checksum = 0;
+    unsigned int droppedFrames = 0;
+    bool lostFrame = false;
+};
+
+#endif // Telemetry_h
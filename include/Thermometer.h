@@ -0,0 +1,38 @@
+/*
+  Thermometer.h
+
+  Ambient temperature for the speed of sound of the sonar. Two sources:
+  - a TMP36 on TEMPERATURE_PIN (-D TEMPERATURE_PIN=A6), for boards that still have an analog pin free
+  - otherwise the temperature sensor inside the ATmega328P: ADC channel 8 against the internal 1.1 V
+    reference. It measures the chip, which runs a little warmer than the air, and every chip is off by
+    up to +-10 degrees: set THERMOMETER_OFFSET once against a real thermometer.
+  The internal reference needs a moment to settle after switching to it, so a measurement takes two
+  steps: select(), then read() THERMOMETER_SETTLE ms later. Switching back to the AVcc reference of
+  analogRead() throws away the first conversion after it, so read() and deselect() block for up to two
+  conversions (~0.2 ms).
+  Without either source (e.g. the native build without TEMPERATURE_PIN) available() is false.
+
+  Temperatures are in 1/10 degrees Celsius.
+*/
+#ifndef Thermometer_h
+#define Thermometer_h
+
+#include <Arduino.h>
+
+#define THERMOMETER_SETTLE 5  //ms for the ADC reference to settle
+#ifndef THERMOMETER_OFFSET
+#define THERMOMETER_OFFSET 0  //1/10 degrees added to the internal sensor
+#endif
+
+class Thermometer {
+  public:
+    bool available();
+    //Switches the ADC to the sensor
+    void select();
+    //Converts and returns the temperature, then deselect()s
+    int read();
+    //Switches the ADC back to analogRead(), for a select() that won't be followed by read()
+    void deselect();
+};
+
+#endif // Thermometer_h
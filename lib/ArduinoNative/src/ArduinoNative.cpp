@@ -0,0 +1,307 @@
+/*
+  ArduinoNative.cpp
+
+  See ArduinoNative.h
+*/
+#include <stdio.h>
+#include <map>
+#include <utility>
+
+#include "ArduinoNative.h"
+#include "EEPROM.h"
+
+//What the calls roughly cost on a 16 MHz ATmega328P, in microseconds
+#define COST_PIN_ACCESS 4
+#define COST_ANALOG_WRITE 8
+#define COST_ANALOG_READ 112
+#define COST_TIME_READ 4
+
+#define SERIAL_TX_BUFFER 64
+#define SERIAL_RX_BUFFER 64
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+uint8_t MCUSR = bit(PORF);
+
+namespace hal {
+
+bool serialEcho = true;
+
+static uint64_t clock = 0;
+static std::multimap<uint64_t, std::pair<EventCallback, void*> > events;
+
+static uint8_t modes[NUM_DIGITAL_PINS];
+static uint8_t outputs[NUM_DIGITAL_PINS];
+static uint8_t inputs[NUM_DIGITAL_PINS];
+static int duties[NUM_DIGITAL_PINS];
+static int analogInputs[A7 + 1];
+
+static void (*isr[NUM_DIGITAL_PINS])();
+static int isrMode[NUM_DIGITAL_PINS];
+static bool isrPending[NUM_DIGITAL_PINS];
+static bool interruptsOn = true;
+
+static Device* firstDevice = NULL;
+
+uint64_t now() {
+  return clock;
+}
+
+void advance(uint32_t us) {
+  uint64_t end = clock + us;
+  while (!events.empty() && events.begin()->first <= end) {
+    std::pair<EventCallback, void*> event = events.begin()->second;
+    if (events.begin()->first > clock)
+      clock = events.begin()->first;
+    events.erase(events.begin());
+    event.first(event.second);
+  }
+  if (end > clock)
+    clock = end;
+}
+
+void schedule(uint64_t at, EventCallback callback, void* context) {
+  events.insert(std::make_pair(at, std::make_pair(callback, context)));
+}
+
+static void runInterrupt(uint8_t pin) {
+  isrPending[pin] = false;
+  interruptsOn = false;
+  isr[pin]();
+  interruptsOn = true;
+}
+
+void setInput(uint8_t pin, uint8_t level) {
+  if (pin >= NUM_DIGITAL_PINS || inputs[pin] == level)
+    return;
+  inputs[pin] = level;
+
+  if (isr[pin] == NULL)
+    return;
+  if (isrMode[pin] == CHANGE || (isrMode[pin] == RISING && level) || (isrMode[pin] == FALLING && !level)) {
+    if (interruptsOn)
+      runInterrupt(pin);
+    else
+      isrPending[pin] = true;
+  }
+}
+
+void setAnalogInput(uint8_t pin, int value) {
+  if (pin <= A7)
+    analogInputs[pin] = constrain(value, 0, 1023);
+}
+
+uint8_t outputLevel(uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? outputs[pin] : LOW;
+}
+
+uint8_t mode(uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? modes[pin] : INPUT;
+}
+
+int pwm(uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? duties[pin] : 0;
+}
+
+Device::Device() {
+  next = firstDevice;
+  firstDevice = this;
+}
+
+Device* devices() {
+  return firstDevice;
+}
+
+} // namespace hal
+
+/****************************************
+  ARDUINO API
+****************************************/
+void pinMode(uint8_t pin, uint8_t mode) {
+  hal::advance(COST_PIN_ACCESS);
+  if (pin >= NUM_DIGITAL_PINS)
+    return;
+  hal::modes[pin] = mode;
+  for (hal::Device* device = hal::devices(); device; device = device->next)
+    device->pinModeSet(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  hal::advance(COST_PIN_ACCESS);
+  if (pin >= NUM_DIGITAL_PINS)
+    return;
+  hal::outputs[pin] = val ? HIGH : LOW;
+  hal::duties[pin] = val ? 255 : 0;
+  for (hal::Device* device = hal::devices(); device; device = device->next)
+    device->pinWritten(pin, hal::outputs[pin]);
+}
+
+int digitalRead(uint8_t pin) {
+  hal::advance(COST_PIN_ACCESS);
+  if (pin >= NUM_DIGITAL_PINS)
+    return LOW;
+  return hal::modes[pin] == OUTPUT ? hal::outputs[pin] : hal::inputs[pin];
+}
+
+void analogWrite(uint8_t pin, int val) {
+  hal::advance(COST_ANALOG_WRITE);
+  if (pin >= NUM_DIGITAL_PINS)
+    return;
+  hal::duties[pin] = constrain(val, 0, 255);
+  hal::outputs[pin] = val > 0 ? HIGH : LOW;
+  for (hal::Device* device = hal::devices(); device; device = device->next)
+    device->pwmWritten(pin, hal::duties[pin]);
+}
+
+int analogRead(uint8_t pin) {
+  hal::advance(COST_ANALOG_READ);
+  if (pin < A0) //channel number instead of pin
+    pin += A0;
+  return pin <= A7 ? hal::analogInputs[pin] : 0;
+}
+
+unsigned long millis() {
+  hal::advance(COST_TIME_READ);
+  return (unsigned long)(hal::now() / 1000);
+}
+
+unsigned long micros() {
+  hal::advance(COST_TIME_READ);
+  return (unsigned long)hal::now();
+}
+
+void delay(unsigned long ms) {
+  hal::advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  hal::advance(us);
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(), int mode) {
+  if (interruptNum >= NUM_DIGITAL_PINS)
+    return;
+  hal::isr[interruptNum] = userFunc;
+  hal::isrMode[interruptNum] = mode;
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+  if (interruptNum < NUM_DIGITAL_PINS)
+    hal::isr[interruptNum] = NULL;
+}
+
+void noInterrupts() {
+  hal::interruptsOn = false;
+}
+
+void interrupts() {
+  hal::interruptsOn = true;
+  for (uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++) {
+    if (hal::isrPending[pin] && hal::isr[pin])
+      hal::runInterrupt(pin);
+  }
+}
+
+/****************************************
+  SERIAL
+  Bytes leave at the configured baud rate through a 64 byte buffer. Writing into a full buffer
+  blocks (lets virtual time pass) just like HardwareSerial does.
+****************************************/
+static uint64_t txBusyUntil = 0;
+static uint32_t byteTime = 1042; //9600 baud, 10 bits per byte
+static uint8_t rxBuffer[SERIAL_RX_BUFFER];
+static uint8_t rxHead = 0;
+static uint8_t rxTail = 0;
+
+//Bytes that don't fit into the receive buffer are lost, like on the real thing
+void hal::serialReceive(const char* text) {
+  for (; *text; text++) {
+    uint8_t next = (rxHead + 1) % SERIAL_RX_BUFFER;
+    if (next == rxTail)
+      return;
+    rxBuffer[rxHead] = *text;
+    rxHead = next;
+  }
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  byteTime = 10000000UL / baud;
+}
+
+int HardwareSerial::available() {
+  return (rxHead + SERIAL_RX_BUFFER - rxTail) % SERIAL_RX_BUFFER;
+}
+
+int HardwareSerial::read() {
+  if (rxHead == rxTail)
+    return -1;
+  uint8_t b = rxBuffer[rxTail];
+  rxTail = (rxTail + 1) % SERIAL_RX_BUFFER;
+  return b;
+}
+
+int HardwareSerial::availableForWrite() {
+  uint64_t now = hal::now();
+  if (txBusyUntil <= now)
+    return SERIAL_TX_BUFFER - 1;
+  int queued = (int)((txBusyUntil - now + byteTime - 1) / byteTime);
+  return queued >= SERIAL_TX_BUFFER - 1 ? 0 : SERIAL_TX_BUFFER - 1 - queued;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  uint64_t now = hal::now();
+  if (txBusyUntil < now)
+    txBusyUntil = now;
+  uint64_t bufferedTime = (uint64_t)(SERIAL_TX_BUFFER - 1) * byteTime;
+  if (txBusyUntil - now > bufferedTime) //buffer full, wait for a slot
+    hal::advance((uint32_t)(txBusyUntil - now - bufferedTime));
+  txBusyUntil += byteTime;
+  if (hal::serialEcho)
+    putchar(b);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size; i++)
+    write(buffer[i]);
+  return size;
+}
+
+size_t HardwareSerial::print(const char* s) {
+  return write((const uint8_t*)s, strlen(s));
+}
+
+size_t HardwareSerial::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(long n, int base) {
+  if (base == DEC) {
+    char text[12];
+    snprintf(text, sizeof(text), "%ld", n);
+    return print(text);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+  char text[34];
+  char* p = text + sizeof(text) - 1;
+  *p = 0;
+  do {
+    uint8_t digit = n % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    n /= base;
+  } while (n);
+  return print(p);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, n);
+  return print(text);
+}
+
+size_t HardwareSerial::println() {
+  return print("\r\n");
+}
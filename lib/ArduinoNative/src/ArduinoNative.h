@@ -0,0 +1,61 @@
+/*
+  ArduinoNative.h
+
+  Simulation side of the host build. The firmware only ever sees the Arduino API (Arduino.h, EEPROM.h),
+  simulated hardware (desk, sensors, buttons) sits behind it as hal::Device objects:
+  - Time is virtual, in microseconds. Every Arduino call costs roughly what it costs on a 16 MHz AVR, so
+    busy-waits terminate and loop() timings are meaningful.
+  - Devices see every pin write and drive the inputs. Input changes fire attached interrupts.
+  - Devices schedule their own events (e.g. an echo edge) on the virtual time line.
+*/
+#ifndef ArduinoNative_h
+#define ArduinoNative_h
+
+#include <Arduino.h>
+
+namespace hal {
+
+typedef void (*EventCallback)(void* context);
+
+//Virtual time in microseconds since start
+uint64_t now();
+//Lets virtual time pass, firing every event that falls into it
+void advance(uint32_t us);
+void schedule(uint64_t at, EventCallback callback, void* context);
+
+//Drives an input pin from outside, fires an attached interrupt on change
+void setInput(uint8_t pin, uint8_t level);
+//Voltage on an analog pin as analogRead() returns it, 0 - 1023
+void setAnalogInput(uint8_t pin, int value);
+uint8_t outputLevel(uint8_t pin);
+uint8_t mode(uint8_t pin);
+//Last analogWrite() duty of a pin, 0 - 255
+int pwm(uint8_t pin);
+
+//Serial output is echoed to stdout while this is true
+extern bool serialEcho;
+//Puts text into the serial receive buffer, as if it was sent from the PC
+void serialReceive(const char* text);
+
+class Device {
+  public:
+    Device();
+    virtual ~Device() {}
+    //Command line of the program, devices pick their own options
+    virtual void begin(int argc, char** argv) {}
+    virtual void pinModeSet(uint8_t pin, uint8_t mode) {}
+    virtual void pinWritten(uint8_t pin, uint8_t level) {}
+    virtual void pwmWritten(uint8_t pin, int duty) {}
+    //The run ends as soon as any device is finished
+    virtual bool finished() { return false; }
+    virtual void end() {}
+
+    Device* next;
+};
+
+//First registered device, devices register themselves on construction
+Device* devices();
+
+} // namespace hal
+
+#endif // ArduinoNative_h
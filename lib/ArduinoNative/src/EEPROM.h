@@ -0,0 +1,36 @@
+/*
+  EEPROM.h (native)
+
+  1 KB of simulated EEPROM (ATmega328P size), erased to 0xFF like a new chip.
+*/
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+#define NATIVE_EEPROM_SIZE 1024
+
+class EEPROMClass {
+  public:
+    EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+
+    uint8_t read(int address) { return data[address]; }
+    void write(int address, uint8_t value) { data[address] = value; }
+    void update(int address, uint8_t value) { data[address] = value; }
+    uint16_t length() { return NATIVE_EEPROM_SIZE; }
+
+    template <class T> T& get(int address, T& value) {
+      memcpy(&value, data + address, sizeof(T));
+      return value;
+    }
+    template <class T> const T& put(int address, const T& value) {
+      memcpy(data + address, &value, sizeof(T));
+      return value;
+    }
+
+    uint8_t data[NATIVE_EEPROM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_h
@@ -0,0 +1,84 @@
+/*
+  NativeMain.cpp
+
+  Entry point of the host build: runs setup() and loop() on virtual time against the registered devices.
+
+  Options:
+    --seconds N   virtual run time (default 10)
+    --quiet       don't echo the firmware's serial output
+    --send TEXT@MS  TEXT arrives on the serial port at MS milliseconds, repeatable
+    --reset CAUSE   what reset the board: power (default), external, brownout or watchdog
+  Devices read their own options from the same command line.
+
+  Left out of the unit tests (pio test defines PIO_UNIT_TESTING): they bring their own main() and no
+  setup()/loop().
+*/
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ArduinoNative.h"
+
+#define LOOP_OVERHEAD_US 4 //call/return of loop() and the core's serial event check
+
+static void sendEvent(void* context) {
+  hal::serialReceive((const char*)context);
+}
+
+static bool anyFinished() {
+  for (hal::Device* device = hal::devices(); device; device = device->next) {
+    if (device->finished())
+      return true;
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  double seconds = 10;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "--quiet") == 0)
+      hal::serialEcho = false;
+    else if (strcmp(argv[i], "--send") == 0 && i + 1 < argc) {
+      char* at = strrchr(argv[++i], '@');
+      if (at == NULL)
+        continue;
+      *at = 0;
+      hal::schedule((uint64_t)(atof(at + 1) * 1000.0), sendEvent, argv[i]);
+    }
+    else if (strcmp(argv[i], "--reset") == 0 && i + 1 < argc) {
+      const char* cause = argv[++i];
+      if (strcmp(cause, "external") == 0)
+        MCUSR = bit(EXTRF);
+      else if (strcmp(cause, "brownout") == 0)
+        MCUSR = bit(BORF);
+      else if (strcmp(cause, "watchdog") == 0)
+        MCUSR = bit(WDRF);
+      else
+        MCUSR = bit(PORF);
+    }
+  }
+
+  for (hal::Device* device = hal::devices(); device; device = device->next)
+    device->begin(argc, argv);
+
+  uint64_t end = (uint64_t)(seconds * 1000000.0);
+  unsigned long loops = 0;
+  setup();
+  while (hal::now() < end && !anyFinished()) {
+    loop();
+    hal::advance(LOOP_OVERHEAD_US);
+    loops++;
+  }
+
+  for (hal::Device* device = hal::devices(); device; device = device->next)
+    device->end();
+  fprintf(stderr, "ran %.3f s virtual time, %lu loop() calls, %.1f us per loop()\n",
+          hal::now() / 1000000.0, loops, loops ? (double)hal::now() / loops : 0.0);
+  return 0;
+}
+
+#endif // PIO_UNIT_TESTING
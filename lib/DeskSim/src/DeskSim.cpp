@@ -0,0 +1,549 @@
+/*
+  DeskSim.cpp
+
+  See DeskSim.h
+
+  The mechanics are a lumped model in cm and seconds, forces normalised to the combined stall force of both
+  motors at 100% duty. Each motor pushes with S * (u - v / v0): u is the signed duty, v0 its no-load speed.
+  The defaults are tuned to the behaviour of the real desk with ~40 kg on it: about 2 cm/s up at
+  PWM_SPEED_UP, about the same down at PWM_SPEED_DOWN, and the spindle holds the desk when unpowered.
+*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EEPROM.h>
+#include <Ultrasonic.h>
+
+#include "DeskSim.h"
+#include "Pins.h"
+#include "StoredProgram.h"
+
+#define PHYSICS_STEP_US 1000
+#define TRACE_INTERVAL_US 10000
+
+#define DESK_WEIGHT 15.0          //kg, the table top itself
+#define NO_LOAD_SPEED 3.2         //cm/s at 100% duty
+#define MOTOR_STALL_FORCE 0.5     //each motor, so both together are 1
+#define MOTOR_STALL_CURRENT 3.0   //A per motor
+#define SENSE_RESISTOR 0.5        //ohm, between the SENSE pins of the L298N and GND
+#define GRAVITY_PER_KG 0.0018     //gravity, relative to the stall force
+#define FRICTION_BASE 0.08        //dynamic friction of the spindle
+#define FRICTION_PER_KG 0.0022    //the spindle gets stiffer with load
+#define STATIC_FRICTION 1.3       //static friction is this much higher than the dynamic one
+#define INERTIA_BASE 0.03         //effective mass incl. the motor rotors seen through the gearing
+#define INERTIA_PER_KG 0.0005
+#define MIN_HEIGHT 63.0           //cm, mechanical end stops
+#define MAX_HEIGHT 128.0
+
+#define SONAR_ECHO_DELAY_US 450   //burst and processing of the HC-SR04 before the echo pin rises
+#define SONAR_TRIGGER_US 8        //shorter trigger pulses are ignored
+#define SONAR_NO_ECHO_US 38000    //without an echo the HC-SR04 holds the echo pin high this long
+#define FIRMWARE_US_PER_CM 56.0   //the Ultrasonic library's CM divisor, times two for the round trip
+
+#define QUIET_TIME_US 3000000ULL  //the run ends this long after the last scripted press once the desk is at rest
+
+DeskSim deskSim;
+
+struct ButtonEdge {
+  uint8_t pin;
+  uint8_t level;
+};
+
+static const struct {
+  uint8_t segments;
+  char symbol;
+} glyphs[] = {
+  {0x00, ' '}, {0x3F, '0'}, {0x06, '1'}, {0x5B, '2'}, {0x4F, '3'}, {0x66, '4'}, {0x6D, '5'}, {0x7D, '6'},
+  {0x07, '7'}, {0x7F, '8'}, {0x6F, '9'}, {0x77, 'A'}, {0x7C, 'b'}, {0x39, 'C'}, {0x5E, 'd'}, {0x79, 'E'},
+  {0x71, 'F'}, {0x73, 'P'}, {0x50, 'r'}, {0x5C, 'o'}, {0x40, '-'}, {0x63, '*'}, {0x08, '_'}, {0x76, 'H'},
+  {0x38, 'L'}, {0x3E, 'U'}, {0x1C, 'u'}, {0x54, 'n'}, {0x74, 'h'}, {0x78, 't'}, {0x6E, 'y'}
+};
+
+static uint8_t buttonPin(const char* name) {
+  if (strcmp(name, "up") == 0)
+    return BUTTON_UP;
+  if (strcmp(name, "down") == 0)
+    return BUTTON_DOWN;
+  if (strcmp(name, "p0") == 0)
+    return BUTTON_POS_0;
+  if (strcmp(name, "p1") == 0)
+    return BUTTON_POS_1;
+  return 0xFF;
+}
+
+static double seconds(uint64_t us) {
+  return us / 1000000.0;
+}
+
+void DeskSim::begin(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* option = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (strcmp(option, "--height") == 0) { h = atof(value); i++; }
+    else if (strcmp(option, "--load") == 0) { load = atof(value); i++; }
+    else if (strcmp(option, "--pos0") == 0) { pos0 = atof(value); i++; }
+    else if (strcmp(option, "--pos1") == 0) { pos1 = atof(value); i++; }
+    else if (strcmp(option, "--noise") == 0) { noise = atof(value); i++; }
+    else if (strcmp(option, "--dropout") == 0) { dropout = atof(value); i++; }
+    else if (strcmp(option, "--silent-dropout") == 0) { silentDropout = true; }
+    else if (strcmp(option, "--spurious") == 0) { spurious = atof(value); i++; }
+    else if (strcmp(option, "--temp") == 0) { temperature = atof(value); i++; }
+    else if (strcmp(option, "--mismatch") == 0) { mismatch = atof(value); i++; }
+    else if (strcmp(option, "--seed") == 0) { seed = (uint32_t)atol(value); if (!seed) seed = 1; i++; }
+    else if (strcmp(option, "--trace") == 0) { trace = fopen(value, "w"); i++; }
+    else if (strcmp(option, "--encoder") == 0) { encoderCountsPerCm = atof(value); i++; }
+    else if (strcmp(option, "--bounce") == 0) { bounce = true; }
+    else if (strcmp(option, "--log") == 0) { logging = true; }
+    else if (strcmp(option, "--press") == 0 && pressCount < DESK_SIM_MAX_PRESSES) {
+      char name[8] = "";
+      double at = 0, duration = 100;
+      sscanf(value, "%7[a-z0-9]@%lf+%lf", name, &at, &duration);
+      Press &press = presses[pressCount];
+      press.pin = buttonPin(name);
+      press.at = (uint64_t)(at * 1000);
+      press.duration = (uint64_t)(duration * 1000);
+      if (press.pin != 0xFF)
+        pressCount++;
+      else
+        fprintf(stderr, "unknown button in --press %s\n", value);
+      i++;
+    }
+  }
+
+  if (pos0 >= 0 || pos1 >= 0) {
+    StoredProgram program;
+    EEPROM.get(0, program);
+    if (pos0 >= 0)
+      program.pos0Height = lround(pos0 * 10);
+    if (pos1 >= 0)
+      program.pos1Height = lround(pos1 * 10);
+    EEPROM.put(0, program);
+  }
+
+#ifdef TEMPERATURE_PIN
+  //TMP36: 500 mV at 0 degrees, 10 mV per degree
+  hal::setAnalogInput(TEMPERATURE_PIN, (int)lround((0.5 + 0.01 * temperature) / 5.0 * 1023));
+#endif
+
+  //Idle levels: buttons pulled down, the TM1637 lines pulled up
+  hal::setInput(CLK, HIGH);
+  hal::setInput(DIO, HIGH);
+
+#ifdef USE_ENCODERS
+  //Both encoders sit on the same shaft, motor B is mounted the other way round
+  const uint8_t encoderPins[2][2] = {{ENCODER_A1, ENCODER_A2}, {ENCODER_B1, ENCODER_B2}};
+  for (uint8_t m = 0; m < 2; m++) {
+    Encoder &encoder = encoders[m];
+    encoder.sim = this;
+    encoder.pinA = encoderPins[m][0];
+    encoder.pinB = encoderPins[m][1];
+    encoder.sign = m == 0 ? 1 : -1;
+    encoder.count = encoderTarget(encoder);
+    encoder.pending = 0;
+    setEncoderPins(encoder);
+  }
+#endif
+
+  for (uint8_t i = 0; i < pressCount; i++) {
+    const Press &press = presses[i];
+    uint64_t edges[2] = {press.at, press.at + press.duration};
+    for (uint8_t e = 0; e < 2; e++) {
+      uint8_t level = e == 0 ? HIGH : LOW;
+      uint64_t at = edges[e];
+      if (bounce) {
+        for (uint8_t b = 0; b < 4; b++, at += 300) {
+          ButtonEdge* edge = new ButtonEdge();
+          edge->pin = press.pin;
+          edge->level = b % 2 == 0 ? level : !level;
+          hal::schedule(at, buttonEvent, edge);
+        }
+      }
+      ButtonEdge* edge = new ButtonEdge();
+      edge->pin = press.pin;
+      edge->level = level;
+      hal::schedule(at, buttonEvent, edge);
+      if (at > lastEventAt)
+        lastEventAt = at;
+    }
+
+    //Remember what was asked for, so the report can judge the move that follows
+    if ((press.pin == BUTTON_POS_0 || press.pin == BUTTON_POS_1) && press.duration < 2000000ULL) {
+      ButtonEdge* request = new ButtonEdge();
+      request->pin = press.pin;
+      request->level = 2;
+      hal::schedule(press.at + press.duration, buttonEvent, request);
+    }
+  }
+
+  if (trace)
+    fprintf(trace, "time_s,height_cm,velocity_cm_s,reading,duty_a,duty_b,current_a,display\n");
+  hal::schedule(hal::now() + PHYSICS_STEP_US, physicsEvent, this);
+}
+
+void DeskSim::buttonEvent(void* context) {
+  ButtonEdge* edge = (ButtonEdge*)context;
+  DeskSim &sim = deskSim;
+  if (edge->level == 2) {
+    sim.pendingTarget = edge->pin == BUTTON_POS_0 ? sim.pos0 : sim.pos1;
+    sim.pendingRequestAt = hal::now();
+  }
+  else {
+    hal::setInput(edge->pin, edge->level);
+    if (edge->level == LOW && (edge->pin == BUTTON_UP || edge->pin == BUTTON_DOWN))
+      sim.lastReleaseAt = hal::now();
+    if (sim.logging)
+      printf("[sim %9.4f] button %d %s\n", seconds(hal::now()), edge->pin, edge->level ? "down" : "up");
+  }
+  delete edge;
+}
+
+/****************************************
+  MECHANICS
+****************************************/
+int8_t DeskSim::bridgeDirection(uint8_t pinA, uint8_t pinB) {
+  uint8_t a = hal::outputLevel(pinA);
+  uint8_t b = hal::outputLevel(pinB);
+  if (a == b)
+    return 0; //both outputs on the same rail: the motor is braked
+  return b ? 1 : -1;
+}
+
+//Force of one motor. The L298N leaves the motor floating while its enable pin is low
+double DeskSim::motorForce(int8_t motor, double u) {
+  double v0 = NO_LOAD_SPEED * (motor == 0 ? 1 + mismatch / 2 : 1 - mismatch / 2);
+  return MOTOR_STALL_FORCE * (u - v / v0);
+}
+
+void DeskSim::step(double dt) {
+  int dutyA = hal::pwm(enA);
+  int dutyB = hal::pwm(enB);
+  double uA = dutyA / 255.0 * bridgeDirection(in1, in2);
+  double uB = dutyB / 255.0 * bridgeDirection(in3, in4);
+  double forceA = dutyA > 0 ? motorForce(0, uA) : 0;
+  double forceB = dutyB > 0 ? motorForce(1, uB) : 0;
+  currentA = forceA / MOTOR_STALL_FORCE * MOTOR_STALL_CURRENT * bridgeDirection(in1, in2);
+  currentB = forceB / MOTOR_STALL_FORCE * MOTOR_STALL_CURRENT * bridgeDirection(in3, in4);
+  current = fabs(currentA) + fabs(currentB);
+  driving = dutyA > 0 || dutyB > 0;
+#ifdef USE_CURRENT_SENSE
+  //Sense resistors of the L298N behind an RC filter: the current while the bridge conducts, averaged over the PWM
+  hal::setAnalogInput(CURRENT_SENSE_A, (int)(fabs(currentA) * dutyA / 255.0 * SENSE_RESISTOR / 5.0 * 1023));
+  hal::setAnalogInput(CURRENT_SENSE_B, (int)(fabs(currentB) * dutyB / 255.0 * SENSE_RESISTOR / 5.0 * 1023));
+#endif
+
+  double mass = DESK_WEIGHT + load;
+  double gravity = GRAVITY_PER_KG * mass;
+  double friction = FRICTION_BASE + FRICTION_PER_KG * mass;
+  double inertia = INERTIA_BASE + INERTIA_PER_KG * mass;
+  double drive = forceA + forceB - gravity;
+
+  if (v == 0 && fabs(drive) <= friction * STATIC_FRICTION)
+    return; //self-locking spindle holds the desk
+
+  double direction = v != 0 ? (v > 0 ? 1 : -1) : (drive > 0 ? 1 : -1);
+  double next = v + (drive - friction * direction) / inertia * dt;
+  if (v != 0 && (next > 0) != (v > 0))
+    next = 0;
+  v = next;
+  h += v * dt;
+  if (h < MIN_HEIGHT || h > MAX_HEIGHT) {
+    h = h < MIN_HEIGHT ? MIN_HEIGHT : MAX_HEIGHT;
+    v = 0;
+  }
+}
+
+void DeskSim::trackMoves() {
+  uint64_t now = hal::now();
+  Move* move = moveCount > 0 ? &moves[moveCount - 1] : NULL;
+  bool open = move != NULL && move->restAt == 0;
+
+  if (driving && !open && moveCount < DESK_SIM_MAX_MOVES) {
+    move = &moves[moveCount++];
+    memset(move, 0, sizeof(Move));
+    move->startAt = now;
+    move->startHeight = h;
+    move->target = pendingTarget;
+    move->requestAt = pendingRequestAt;
+    pendingTarget = -1;
+    open = true;
+  }
+  if (!open)
+    return;
+
+  if (driving) {
+    //go by the motion, the bridge pins may still be half way through a direction change
+    if (move->direction == 0 && v != 0)
+      move->direction = v > 0 ? 1 : -1;
+    move->stopAt = 0;
+    if (current > move->peakCurrent)
+      move->peakCurrent = current;
+    move->charge += current * PHYSICS_STEP_US / 1000000.0;
+    move->chargeA += currentA * PHYSICS_STEP_US / 1000000.0;
+    move->chargeB += currentB * PHYSICS_STEP_US / 1000000.0;
+  }
+  else if (move->stopAt == 0) {
+    move->stopAt = stopCommandAt > move->startAt ? stopCommandAt : now;
+    move->stopHeight = h;
+    move->releaseAt = lastReleaseAt > move->startAt ? lastReleaseAt : 0;
+  }
+  else if (v == 0) {
+    move->restAt = now;
+    move->restHeight = h;
+    move->restReading = idealReading();
+  }
+}
+
+/****************************************
+  ENCODERS
+  The counts the shaft moved during a physics step are spread evenly over the next step, one event
+  per edge, so the firmware sees them at the rate the real encoders produce them.
+****************************************/
+long DeskSim::encoderTarget(const Encoder &encoder) {
+  return lround(h * encoderCountsPerCm) * encoder.sign;
+}
+
+void DeskSim::setEncoderPins(const Encoder &encoder) {
+  static const uint8_t phases[4][2] = {{LOW, LOW}, {LOW, HIGH}, {HIGH, HIGH}, {HIGH, LOW}};
+  const uint8_t* phase = phases[encoder.count & 3];
+  hal::setInput(encoder.pinA, phase[0]);
+  hal::setInput(encoder.pinB, phase[1]);
+}
+
+void DeskSim::scheduleEncoders() {
+  uint64_t now = hal::now();
+  for (uint8_t m = 0; m < (encoderCountsPerCm > 0 ? 2 : 0); m++) {
+    Encoder &encoder = encoders[m];
+    if (encoder.pinA == encoder.pinB)
+      continue;
+    long steps = encoderTarget(encoder) - encoder.count - encoder.pending;
+    long edges = labs(steps);
+    for (long i = 0; i < edges; i++)
+      hal::schedule(now + (i + 1) * PHYSICS_STEP_US / (edges + 1), encoderEvent, &encoder);
+    encoder.pending += steps;
+  }
+}
+
+void DeskSim::encoderEvent(void* context) {
+  Encoder &encoder = *(Encoder*)context;
+  int8_t direction = encoder.pending > 0 ? 1 : -1;
+  encoder.pending -= direction;
+  encoder.count += direction;
+  encoder.sim->setEncoderPins(encoder);
+}
+
+void DeskSim::physicsEvent(void* context) {
+  DeskSim* sim = (DeskSim*)context;
+  uint64_t now = hal::now();
+  sim->step(PHYSICS_STEP_US / 1000000.0);
+  sim->scheduleEncoders();
+  sim->trackMoves();
+  if (sim->driving || sim->v != 0)
+    sim->restSince = now;
+
+  if (sim->trace && now >= sim->nextTraceAt) {
+    fprintf(sim->trace, "%.3f,%.3f,%.3f,%.2f,%d,%d,%.2f,\"%s\"\n", seconds(now), sim->h, sim->v, sim->idealReading(),
+            hal::pwm(enA) * sim->bridgeDirection(in1, in2), hal::pwm(enB) * sim->bridgeDirection(in3, in4),
+            sim->current, sim->text);
+    sim->nextTraceAt = now + TRACE_INTERVAL_US;
+  }
+  hal::schedule(now + PHYSICS_STEP_US, physicsEvent, sim);
+}
+
+/****************************************
+  HC-SR04
+****************************************/
+//The firmware compensates the temperature, what it reads is the reading at REFERENCE_TEMPERATURE
+double DeskSim::idealReading() {
+  double speedOfSound = 331.3 + 0.606 * REFERENCE_TEMPERATURE / 10; //m/s
+  return h * 2e4 / speedOfSound / FIRMWARE_US_PER_CM;
+}
+
+void DeskSim::ping() {
+  if (echoing)
+    return;
+  bool lost = random() < dropout;
+  if (lost && silentDropout)
+    return;
+
+  double distance = h + gaussian() * noise;
+  if (random() < spurious)
+    distance = 20 + random() * 100;
+  double speedOfSound = 331.3 + 0.606 * temperature;
+  echoDuration = lost ? SONAR_NO_ECHO_US : distance * 2e4 / speedOfSound;
+  echoing = true;
+  hal::schedule(hal::now() + SONAR_ECHO_DELAY_US, echoStartEvent, this);
+}
+
+void DeskSim::echoStartEvent(void* context) {
+  DeskSim* sim = (DeskSim*)context;
+  hal::setInput(ECHO_PIN, HIGH);
+  hal::schedule(hal::now() + (uint64_t)sim->echoDuration, echoEndEvent, sim);
+}
+
+void DeskSim::echoEndEvent(void* context) {
+  DeskSim* sim = (DeskSim*)context;
+  hal::setInput(ECHO_PIN, LOW);
+  sim->echoing = false;
+}
+
+void DeskSim::pwmWritten(uint8_t pin, int duty) {
+  if ((pin == enA || pin == enB) && hal::pwm(enA) == 0 && hal::pwm(enB) == 0)
+    stopCommandAt = hal::now();
+}
+
+void DeskSim::pinWritten(uint8_t pin, uint8_t level) {
+  if ((pin == enA || pin == enB) && !level)
+    pwmWritten(pin, 0);
+  if (pin == TRIGGER_PIN) {
+    if (level)
+      triggerHighAt = hal::now();
+    else if (triggerHighAt != 0 && hal::now() - triggerHighAt >= SONAR_TRIGGER_US)
+      ping();
+    if (!level)
+      triggerHighAt = 0;
+  }
+  else if (pin == CLK || pin == DIO) {
+    tm1637Edge();
+  }
+}
+
+/****************************************
+  TM1637
+  Open drain bus: a pin in OUTPUT mode pulls the line low, in INPUT mode the pull-up wins.
+  The simulated chip acknowledges every byte by pulling DIO low during the 9th clock.
+****************************************/
+void DeskSim::pinModeSet(uint8_t pin, uint8_t mode) {
+  if (pin == CLK || pin == DIO)
+    tm1637Edge();
+}
+
+void DeskSim::tm1637Edge() {
+  bool clkNow = !(hal::mode(CLK) == OUTPUT && hal::outputLevel(CLK) == LOW);
+  bool acking = bitCount >= 8;
+  bool dioNow = !(hal::mode(DIO) == OUTPUT && hal::outputLevel(DIO) == LOW) && !acking;
+
+  if (clk && clkNow && dio != dioNow) {
+    if (!dioNow) { //start
+      receiving = true;
+      bitCount = 0;
+      shift = 0;
+      byteIndex = 0;
+    }
+    else { //stop
+      receiving = false;
+      tm1637Render();
+    }
+  }
+  else if (receiving && !clk && clkNow) { //rising clock edge, sample
+    if (bitCount < 8) {
+      shift |= (dioNow ? 1 : 0) << bitCount;
+      bitCount++;
+    }
+    else {
+      bitCount++;
+    }
+  }
+  else if (receiving && clk && !clkNow) { //falling clock edge
+    if (bitCount == 8) {
+      tm1637Byte(shift);
+      hal::setInput(DIO, LOW); //acknowledge
+    }
+    else if (bitCount > 8) {
+      hal::setInput(DIO, HIGH);
+      bitCount = 0;
+      shift = 0;
+      dioNow = !(hal::mode(DIO) == OUTPUT && hal::outputLevel(DIO) == LOW);
+    }
+  }
+  clk = clkNow;
+  dio = dioNow;
+}
+
+void DeskSim::tm1637Byte(uint8_t b) {
+  if (byteIndex++ == 0) {
+    if ((b & 0xC0) == 0xC0)
+      address = b & 0x03;
+    else
+      address = 0xFF; //data or display control command, no segment data follows
+    return;
+  }
+  if (address == 0xFF)
+    return;
+
+  segments[address & 0x03] = b;
+  address++;
+}
+
+//Called at the end of every bus transaction, so half-written updates never show up
+void DeskSim::tm1637Render() {
+  char rendered[sizeof(text)];
+  uint8_t length = 0;
+  for (uint8_t digit = 0; digit < 4; digit++) {
+    char symbol = '?';
+    for (uint8_t g = 0; g < sizeof(glyphs) / sizeof(glyphs[0]); g++) {
+      if (glyphs[g].segments == (segments[digit] & 0x7F))
+        symbol = glyphs[g].symbol;
+    }
+    rendered[length++] = symbol;
+    if (segments[digit] & 0x80)
+      rendered[length++] = '.';
+  }
+  rendered[length] = 0;
+  if (strcmp(rendered, text) != 0) {
+    strcpy(text, rendered);
+    if (logging)
+      printf("[sim %9.4f] display \"%s\"\n", seconds(hal::now()), text);
+  }
+}
+
+/****************************************
+  RUN CONTROL AND REPORT
+****************************************/
+bool DeskSim::finished() {
+  uint64_t now = hal::now();
+  return pressCount > 0 && now > lastEventAt + QUIET_TIME_US && now - restSince > QUIET_TIME_US &&
+         (moveCount == 0 || moves[moveCount - 1].restAt != 0);
+}
+
+void DeskSim::end() {
+  if (trace)
+    fclose(trace);
+
+  printf("--- desk simulation: %.0f kg load ---\n", load);
+  for (uint8_t i = 0; i < moveCount; i++) {
+    const Move &move = moves[i];
+    if (move.restAt == 0) {
+      printf("move %d: %s from %.2f cm, still moving at the end of the run\n", i + 1, move.direction > 0 ? "up" : "down",
+             move.startHeight);
+      continue;
+    }
+    double driven = seconds(move.stopAt - move.startAt);
+    double average = driven > 0 ? move.charge / driven : 0;
+    printf("move %d: %-4s %.2f -> %.2f cm in %.2f s, coast %.2f cm, current peak %.2f A mean %.2f A\n", i + 1,
+           move.direction > 0 ? "up" : "down", move.startHeight, move.restHeight, seconds(move.restAt - move.startAt),
+           fabs(move.restHeight - move.stopHeight), move.peakCurrent, average);
+    if (driven > 0)
+      printf("        motor A %+.2f A, motor B %+.2f A mean (negative: driven by the other one)\n",
+             move.chargeA / driven, move.chargeB / driven);
+    if (move.target >= 0) {
+      printf("        target %.1f: rest reading %.2f, overshoot %+.2f, time to target %.2f s\n", move.target,
+             move.restReading, (move.restReading - move.target) * move.direction,
+             seconds(move.restAt - move.requestAt));
+    }
+    if (move.releaseAt != 0 && move.stopAt >= move.releaseAt)
+      printf("        motors off %.2f ms after the button was released\n", (move.stopAt - move.releaseAt) / 1000.0);
+  }
+  printf("final height %.2f cm (reading %.2f), display \"%s\"\n", h, idealReading(), text);
+}
+
+double DeskSim::random() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed / 4294967296.0;
+}
+
+double DeskSim::gaussian() {
+  double u = random() + 1e-12;
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * random());
+}
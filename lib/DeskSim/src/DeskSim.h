@@ -0,0 +1,172 @@
+/*
+  DeskSim.h
+
+  Simulated Skarsta desk for the native build. Plugs in behind the Arduino API (hal::Device) and models:
+  - the spindle driven by two DC gearmotors through the L298N: PWM duty and direction from enA/enB and
+    in1..in4, back-EMF, load, inertia, gravity (helps on the way down), friction and the self-locking
+    spindle that holds the desk when the motors are off. The desk coasts after stopMoving().
+  - the HC-SR04 on TRIGGER_PIN/ECHO_PIN, including noise, dropouts and spurious echoes
+  - the TM1637 bus on CLK/DIO, decoded back into the text shown on the display
+  - the quadrature encoders of both motors (if the firmware is built with USE_ENCODERS)
+  - the current sense outputs of the L298N (if the firmware is built with USE_CURRENT_SENSE)
+  - scripted button presses
+
+  At the end of the run every move of the desk is reported: travel, time, coast, overshoot against the
+  preset that was requested, stop latency after a button release and motor current.
+
+  Options (besides the ones of NativeMain.cpp):
+    --height CM          start height (default 75)
+    --load KG            load on the desk (default 40)
+    --pos0 CM --pos1 CM  presets written to EEPROM before setup() (in sensor readings, the firmware saves them in mm)
+    --press BUTTON@MS[+MS]  press up, down, p0 or p1 at a time for a duration (default 100 ms), repeatable
+    --noise CM           sonar noise, standard deviation (default 0.2)
+    --dropout P          probability that a ping gets no echo: the echo pin stays high for the sensor's
+                         own 38 ms timeout, as on the HC-SR04 (default 0)
+    --silent-dropout     a lost ping doesn't raise the echo pin at all (the old model)
+    --spurious P         probability that a ping returns a random distance (default 0)
+    --temp C             air temperature, sets the speed of sound and the TMP36 on TEMPERATURE_PIN (default 20)
+    --mismatch F         motor B is this much slower than motor A (default 0.05)
+    --encoder N          encoder counts per cm of desk travel (default 5333), 0 = encoders not connected
+    --bounce             buttons bounce for a couple of milliseconds on every edge
+    --seed N             random seed (0 runs as 1, the generator needs a nonzero state)
+    --trace FILE         CSV trace of the run, one line every 10 ms
+    --log                log display changes and button presses
+*/
+#ifndef DeskSim_h
+#define DeskSim_h
+
+#include <stdio.h>
+#include <ArduinoNative.h>
+
+#define DESK_SIM_MAX_PRESSES 32
+#define DESK_SIM_MAX_MOVES 32
+
+class DeskSim : public hal::Device {
+  public:
+    void begin(int argc, char** argv);
+    void pinModeSet(uint8_t pin, uint8_t mode);
+    void pinWritten(uint8_t pin, uint8_t level);
+    void pwmWritten(uint8_t pin, int duty);
+    bool finished();
+    void end();
+
+    //True desk height in cm and its speed in cm/s
+    double height() { return h; }
+    double velocity() { return v; }
+    //What a perfect sensor would read at the current height, in the firmware's units
+    double idealReading();
+    //Text currently shown on the display
+    const char* displayText() { return text; }
+
+  private:
+    struct Press {
+      uint8_t pin;
+      uint64_t at;
+      uint64_t duration;
+    };
+    struct Encoder {
+      DeskSim* sim;
+      uint8_t pinA;
+      uint8_t pinB;
+      int8_t sign;
+      long count;       //position the pins show
+      long pending;     //edges scheduled but not yet fired
+    };
+    struct Move {
+      int8_t direction;
+      uint64_t startAt;
+      uint64_t stopAt;
+      uint64_t restAt;
+      double startHeight;
+      double stopHeight;
+      double restReading;
+      double restHeight;
+      double peakCurrent;
+      double charge;
+      double chargeA;          //positive while the motor drives, negative while it is dragged along
+      double chargeB;
+      double target;           //preset requested for this move in cm, -1 if manual
+      uint64_t requestAt;      //release of the preset button
+      uint64_t releaseAt;      //release of up/down that stopped a manual move
+    };
+
+    static void physicsEvent(void* context);
+    static void echoStartEvent(void* context);
+    static void echoEndEvent(void* context);
+    static void buttonEvent(void* context);
+    static void encoderEvent(void* context);
+
+    void step(double dt);
+    double motorForce(int8_t motor, double u);
+    int8_t bridgeDirection(uint8_t pinA, uint8_t pinB);
+    void trackMoves();
+    long encoderTarget(const Encoder &encoder);
+    void setEncoderPins(const Encoder &encoder);
+    void scheduleEncoders();
+    void ping();
+    void tm1637Edge();
+    void tm1637Byte(uint8_t b);
+    void tm1637Render();
+    double random();
+    double gaussian();
+
+    //Desk state
+    double h = 75;
+    double v = 0;
+    double load = 40;
+    double mismatch = 0.05;
+    double current = 0;
+    double currentA = 0;
+    double currentB = 0;
+    bool driving = false;
+    uint64_t stopCommandAt = 0;
+
+    //Sonar
+    double noise = 0.2;
+    double dropout = 0;
+    bool silentDropout = false;
+    double spurious = 0;
+    double temperature = 20;
+    uint64_t triggerHighAt = 0;
+    bool echoing = false;
+    double echoDuration = 0;
+
+    //Encoders
+    Encoder encoders[2] = {};
+    double encoderCountsPerCm = 5333;
+
+    //Buttons
+    Press presses[DESK_SIM_MAX_PRESSES];
+    uint8_t pressCount = 0;
+    bool bounce = false;
+    uint64_t lastEventAt = 0;
+    double pos0 = -1;
+    double pos1 = -1;
+    double pendingTarget = -1;
+    uint64_t pendingRequestAt = 0;
+    uint64_t lastReleaseAt = 0;
+
+    //Display
+    bool clk = true;
+    bool dio = true;
+    bool receiving = false;
+    uint8_t bitCount = 0;
+    uint8_t shift = 0;
+    uint8_t byteIndex = 0;
+    uint8_t address = 0;
+    uint8_t segments[4] = {0, 0, 0, 0};
+    char text[9] = "    "; //a dot follows the digit it is lit on
+
+    //Report
+    Move moves[DESK_SIM_MAX_MOVES];
+    uint8_t moveCount = 0;
+    uint64_t restSince = 0;
+    uint32_t seed = 1;
+    FILE* trace = NULL;
+    uint64_t nextTraceAt = 0;
+    bool logging = false;
+};
+
+extern DeskSim deskSim;
+
+#endif // DeskSim_h
@@ -0,0 +1,70 @@
+/*
+ * FastPin.h
+ *
+ * Pin access resolved at compile time. FastPin<7>::high() compiles to a single sbi on the port of
+ * pin 7, where digitalWrite() looks the port and bit up in tables and disables the PWM on every call
+ * (some 50-70 cycles). sbi/cbi are atomic, so pins that share a port with an interrupt handler
+ * can be written without disabling interrupts.
+ *
+ * The pin numbers are those of the Arduino Uno/Nano (ATmega328P): 0-7 on PORTD, 8-13 on PORTB,
+ * 14-19 (A0-A5) on PORTC. On other boards and in the native build the functions fall back to
+ * the Arduino core.
+ *
+ * For open drain buses (e.g. the TM1637) leave the pin LOW and switch between input() (released,
+ * pulled up) and output() (driven low).
+ */
+
+#ifndef FastPin_h
+#define FastPin_h
+
+#include <Arduino.h>
+
+#if defined(__AVR_ATmega328P__)
+
+namespace fastpin {
+  // Data space addresses of PORTD, PORTB and PORTC. DDRx is one below PORTx, PINx two below
+  const uint8_t PORT_D = 0x2B;
+  const uint8_t PORT_B = 0x25;
+  const uint8_t PORT_C = 0x28;
+  constexpr uint8_t port(uint8_t pin) { return pin < 8 ? PORT_D : pin < 14 ? PORT_B : PORT_C; }
+  constexpr uint8_t mask(uint8_t pin) { return 1 << (pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14); }
+  // Bit of pin in the port register at address, 0 if the pin is on another port
+  constexpr uint8_t maskIn(uint8_t address, uint8_t pin) { return port(pin) == address ? mask(pin) : 0; }
+  inline volatile uint8_t& reg(uint8_t address) { return *(volatile uint8_t*)(uint16_t)address; }
+}
+
+template <uint8_t pin>
+class FastPin {
+  static_assert(pin < 20, "FastPin only knows the digital pins 0-19");
+  static constexpr uint8_t PORT = fastpin::port(pin);
+  static constexpr uint8_t DDR = PORT - 1;
+  static constexpr uint8_t PIN = PORT - 2;
+  static constexpr uint8_t MASK = fastpin::mask(pin);
+
+  public:
+    static void output() { fastpin::reg(DDR) |= MASK; }
+    static void input() { fastpin::reg(DDR) &= ~MASK; fastpin::reg(PORT) &= ~MASK; }
+    static void inputPullup() { fastpin::reg(DDR) &= ~MASK; fastpin::reg(PORT) |= MASK; }
+    static void high() { fastpin::reg(PORT) |= MASK; }
+    static void low() { fastpin::reg(PORT) &= ~MASK; }
+    static void write(bool value) { if (value) high(); else low(); }
+    static bool read() { return fastpin::reg(PIN) & MASK; }
+};
+
+#else
+
+template <uint8_t pin>
+class FastPin {
+  public:
+    static void output() { pinMode(pin, OUTPUT); }
+    static void input() { pinMode(pin, INPUT); }
+    static void inputPullup() { pinMode(pin, INPUT_PULLUP); }
+    static void high() { digitalWrite(pin, HIGH); }
+    static void low() { digitalWrite(pin, LOW); }
+    static void write(bool value) { digitalWrite(pin, value ? HIGH : LOW); }
+    static bool read() { return digitalRead(pin); }
+};
+
+#endif
+
+#endif // FastPin_h
@@ -0,0 +1,116 @@
+/*
+ * L298NDriver.h
+ *
+ * Both channels of an L298N dual H-bridge, with the pins fixed at compile time:
+ * enable (PWM) and the two direction inputs of channel A and of channel B. The PWM on the enables
+ * comes from a backend of MotorPwm.h, analogWrite() unless another one is given.
+ *
+ * drive() takes a signed 10 bit duty per channel. Positive runs a channel forward (IN1/IN3 HIGH,
+ * IN2/IN4 LOW), unless the channel is inverted, which lets a motor mounted the other way round
+ * turn with the same sign. When a channel changes its direction
+ * - the enables of the channels that reverse go LOW first, the bridge floats
+ * - all four direction inputs are written at once: one masked write per port they are on,
+ *   with interrupts off, so no half-switched state is ever seen on an enabled bridge
+ * - after deadTime microseconds for the bridge to turn off, the PWM starts again
+ * Duty 0 only turns the enable off, the direction inputs stay as they are.
+ *
+ * On other boards than the Uno/Nano and in the native build the direction inputs are written
+ * one after the other, still with the enables off.
+ */
+
+#ifndef L298NDriver_h
+#define L298NDriver_h
+
+#include <Arduino.h>
+#include <FastPin.h>
+#include "MotorPwm.h"
+
+#define L298N_DEAD_TIME 10 // us between switching the direction and enabling the bridge again
+
+template <uint8_t enA, uint8_t in1, uint8_t in2, uint8_t enB, uint8_t in3, uint8_t in4, class Pwm = AnalogPwm>
+class L298NDriver {
+  static_assert(Pwm::supports(enA) && Pwm::supports(enB), "the PWM backend can't drive the enable pins");
+
+  public:
+    L298NDriver(bool invertA = false, bool invertB = false, unsigned int deadTime = L298N_DEAD_TIME)
+      : invertA(invertA), invertB(invertB), deadTime(deadTime) {}
+
+    // Pins to outputs, both channels off
+    void begin() {
+      FastPin<enA>::low();
+      FastPin<enB>::low();
+      FastPin<enA>::output();
+      FastPin<enB>::output();
+      Pwm::begin();
+      writeDirections(forwardA, forwardB);
+      FastPin<in1>::output();
+      FastPin<in2>::output();
+      FastPin<in3>::output();
+      FastPin<in4>::output();
+    }
+
+    // Signed duties -MOTOR_PWM_MAX..MOTOR_PWM_MAX
+    void drive(int dutyA, int dutyB) {
+      bool nextA = dutyA != 0 ? dutyA > 0 : forwardA;
+      bool nextB = dutyB != 0 ? dutyB > 0 : forwardB;
+      if (nextA != forwardA || nextB != forwardB) {
+        if (nextA != forwardA)
+          Pwm::write(enA, 0);
+        if (nextB != forwardB)
+          Pwm::write(enB, 0);
+        writeDirections(nextA, nextB);
+        forwardA = nextA;
+        forwardB = nextB;
+        delayMicroseconds(deadTime);
+      }
+      Pwm::write(enA, abs(dutyA));
+      Pwm::write(enB, abs(dutyB));
+    }
+
+    void stop() { drive(0, 0); }
+
+  private:
+    bool invertA;
+    bool invertB;
+    unsigned int deadTime;
+    bool forwardA = true;
+    bool forwardB = true;
+
+#if defined(__AVR_ATmega328P__)
+    // Direction inputs as levels: bit 0 in1, bit 1 in2, bit 2 in3, bit 3 in4
+    static void writePort(uint8_t address, uint8_t levels) {
+      const uint8_t mask = fastpin::maskIn(address, in1) | fastpin::maskIn(address, in2)
+                         | fastpin::maskIn(address, in3) | fastpin::maskIn(address, in4);
+      if (mask == 0)
+        return;
+      uint8_t value = (levels & 0x01 ? fastpin::maskIn(address, in1) : 0)
+                    | (levels & 0x02 ? fastpin::maskIn(address, in2) : 0)
+                    | (levels & 0x04 ? fastpin::maskIn(address, in3) : 0)
+                    | (levels & 0x08 ? fastpin::maskIn(address, in4) : 0);
+      fastpin::reg(address) = (fastpin::reg(address) & ~mask) | value;
+    }
+
+    void writeDirections(bool nextA, bool nextB) {
+      bool highA = nextA != invertA;
+      bool highB = nextB != invertB;
+      uint8_t levels = (highA ? 0x01 : 0x02) | (highB ? 0x04 : 0x08);
+      uint8_t oldSREG = SREG;
+      cli();
+      writePort(fastpin::PORT_D, levels);
+      writePort(fastpin::PORT_B, levels);
+      writePort(fastpin::PORT_C, levels);
+      SREG = oldSREG;
+    }
+#else
+    void writeDirections(bool nextA, bool nextB) {
+      bool highA = nextA != invertA;
+      bool highB = nextB != invertB;
+      FastPin<in1>::write(highA);
+      FastPin<in2>::write(!highA);
+      FastPin<in3>::write(highB);
+      FastPin<in4>::write(!highB);
+    }
+#endif
+};
+
+#endif // L298NDriver_h
@@ -0,0 +1,84 @@
+/*
+ * MotorPwm.h
+ *
+ * PWM backends for the enable pins of L298NDriver. Both take 10 bit duties, 0 - MOTOR_PWM_MAX.
+ *
+ * AnalogPwm: analogWrite() on any PWM pin, the duty cut down to its 8 bits. The frequency is whatever
+ * the core sets up for the timer of the pin: about 980 Hz on pins 5/6, 490 Hz on the others.
+ *
+ * Timer1Pwm: pins 9 (OC1A) and 10 (OC1B) of the Uno/Nano, both from Timer1 in phase correct mode with
+ * TOP = ICR1 = TIMER1_PWM_TOP: 16 MHz / (2 * 400) = 20 kHz, above hearing, and both motors switch in
+ * step. The duty is scaled to the 401 steps of the timer. Timer0 and with it millis()/micros() stay
+ * untouched; analogWrite() must not be used on pins 9 and 10 afterwards.
+ * In the native build it falls back to analogWrite() like AnalogPwm.
+ */
+
+#ifndef MotorPwm_h
+#define MotorPwm_h
+
+#include <Arduino.h>
+#include <FastPin.h>
+
+#define MOTOR_PWM_MAX 1023
+#define TIMER1_PWM_TOP 400 // 20 kHz
+
+class AnalogPwm {
+  public:
+    static constexpr bool supports(uint8_t pin) { return pin < NUM_DIGITAL_PINS; }
+    static void begin() {}
+    static void write(uint8_t pin, int duty) { analogWrite(pin, duty >> 2); }
+};
+
+#if defined(__AVR_ATmega328P__)
+
+class Timer1Pwm {
+  public:
+    static constexpr bool supports(uint8_t pin) { return pin == 9 || pin == 10; }
+
+    static void begin() {
+      FastPin<9>::low();
+      FastPin<10>::low();
+      TCCR1B = 0;
+      TCNT1 = 0;
+      OCR1A = 0;
+      OCR1B = 0;
+      ICR1 = TIMER1_PWM_TOP;
+      TCCR1A = _BV(WGM11);              // mode 10: phase correct, TOP = ICR1
+      TCCR1B = _BV(WGM13) | _BV(CS10);  // no prescaler
+    }
+
+    // Duty 0 disconnects the pin from the timer, it stays LOW. OCR1x is double buffered, a new duty
+    // starts with the next PWM period
+    static void write(uint8_t pin, int duty) {
+      uint16_t compare = (uint32_t)constrain(duty, 0, MOTOR_PWM_MAX) * TIMER1_PWM_TOP / MOTOR_PWM_MAX;
+      if (pin == 9) {
+        OCR1A = compare;
+        if (compare > 0)
+          TCCR1A |= _BV(COM1A1);
+        else
+          TCCR1A &= ~_BV(COM1A1);
+      }
+      else if (pin == 10) {
+        OCR1B = compare;
+        if (compare > 0)
+          TCCR1A |= _BV(COM1B1);
+        else
+          TCCR1A &= ~_BV(COM1B1);
+      }
+    }
+};
+
+#else
+
+class Timer1Pwm {
+  public:
+    static constexpr bool supports(uint8_t pin) { return pin == 9 || pin == 10; }
+    static void begin() {}
+    static void write(uint8_t pin, int duty) {
+      analogWrite(pin, ((long)constrain(duty, 0, MOTOR_PWM_MAX) * 255 + MOTOR_PWM_MAX / 2) / MOTOR_PWM_MAX);
+    }
+};
+
+#endif
+
+#endif // MotorPwm_h
@@ -0,0 +1,82 @@
+/*
+ * PinChange.cpp
+ *
+ * See PinChange.h
+ */
+
+#include "PinChange.h"
+
+#if defined(__AVR__) && defined(PCICR)
+
+#include <avr/interrupt.h>
+
+#define PIN_CHANGE_GROUPS 3
+
+static PinChangeCallback callbacks[PIN_CHANGE_GROUPS][8];
+static volatile uint8_t* inputRegister[PIN_CHANGE_GROUPS];
+static volatile uint8_t* maskRegister[PIN_CHANGE_GROUPS];
+static volatile uint8_t lastState[PIN_CHANGE_GROUPS];
+
+void attachPinChange(uint8_t pin, PinChangeCallback callback) {
+  volatile uint8_t* pcicr = digitalPinToPCICR(pin);
+  if (pcicr == 0)
+    return;
+
+  uint8_t group = digitalPinToPCICRbit(pin);
+  uint8_t bit = digitalPinToPCMSKbit(pin);
+  uint8_t oldSREG = SREG;
+  cli();
+  inputRegister[group] = portInputRegister(digitalPinToPort(pin));
+  maskRegister[group] = digitalPinToPCMSK(pin);
+  callbacks[group][bit] = callback;
+  lastState[group] = *inputRegister[group];
+  *maskRegister[group] |= _BV(bit);
+  *pcicr |= _BV(group);
+  SREG = oldSREG;
+}
+
+void detachPinChange(uint8_t pin) {
+  volatile uint8_t* pcicr = digitalPinToPCICR(pin);
+  if (pcicr == 0)
+    return;
+
+  uint8_t group = digitalPinToPCICRbit(pin);
+  uint8_t oldSREG = SREG;
+  cli();
+  *digitalPinToPCMSK(pin) &= ~_BV(digitalPinToPCMSKbit(pin));
+  callbacks[group][digitalPinToPCMSKbit(pin)] = 0;
+  if (*digitalPinToPCMSK(pin) == 0)
+    *pcicr &= ~_BV(group);
+  SREG = oldSREG;
+}
+
+static inline void dispatch(uint8_t group) {
+  uint8_t state = *inputRegister[group];
+  uint8_t changed = (state ^ lastState[group]) & *maskRegister[group];
+  lastState[group] = state;
+
+  for (uint8_t bit = 0; changed; bit++, changed >>= 1) {
+    if ((changed & 0x01) && callbacks[group][bit])
+      callbacks[group][bit]();
+  }
+}
+
+ISR(PCINT0_vect) { dispatch(0); }
+#if defined(PCINT1_vect)
+ISR(PCINT1_vect) { dispatch(1); }
+#endif
+#if defined(PCINT2_vect)
+ISR(PCINT2_vect) { dispatch(2); }
+#endif
+
+#else
+
+void attachPinChange(uint8_t pin, PinChangeCallback callback) {
+  attachInterrupt(digitalPinToInterrupt(pin), callback, CHANGE);
+}
+
+void detachPinChange(uint8_t pin) {
+  detachInterrupt(digitalPinToInterrupt(pin));
+}
+
+#endif
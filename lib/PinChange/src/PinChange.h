@@ -0,0 +1,21 @@
+/*
+ * PinChange.h
+ *
+ * Shares the AVR pin change interrupts (PCINT0..2) between several users.
+ * Every pin can get its own callback, the library owns the interrupt vectors and dispatches
+ * to the callbacks of the pins that actually changed. Callbacks run in interrupt context.
+ *
+ * On other architectures the callback is attached with attachInterrupt(..., CHANGE).
+ */
+
+#ifndef PinChange_h
+#define PinChange_h
+
+#include <Arduino.h>
+
+typedef void (*PinChangeCallback)();
+
+void attachPinChange(uint8_t pin, PinChangeCallback callback);
+void detachPinChange(uint8_t pin);
+
+#endif // PinChange_h
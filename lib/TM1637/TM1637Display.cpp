@@ -24,46 +24,44 @@ extern "C" {
 #include <TM1637Display.h>
 #include <Arduino.h>
 
+#if defined(__AVR_ATmega328P__)
+#include <avr/interrupt.h>
+
+void (*volatile tm1637Tick)() = 0;
+
+ISR(TIMER2_COMPA_vect)
+{
+	if (tm1637Tick)
+		tm1637Tick();
+}
+#endif
+
 #define TM1637_I2C_COMM1    0x40
 #define TM1637_I2C_COMM2    0xC0
 #define TM1637_I2C_COMM3    0x80
 
-//
-//      A
-//     ---
-//  F |   | B
-//     -G-
-//  E |   | C
-//     ---
-//      D
-const uint8_t digitToSegment[] = {
- // XGFEDCBA
-  0b00111111,    // 0
-  0b00000110,    // 1
-  0b01011011,    // 2
-  0b01001111,    // 3
-  0b01100110,    // 4
-  0b01101101,    // 5
-  0b01111101,    // 6
-  0b00000111,    // 7
-  0b01111111,    // 8
-  0b01101111,    // 9
-  0b01110111,    // A
-  0b01111100,    // b
-  0b00111001,    // C
-  0b01011110,    // d
-  0b01111001,    // E
-  0b01110001     // F
-  };
-
 static const uint8_t minusSegments = 0b01000000;
 
+constexpr uint8_t TM1637Font::segments[] PROGMEM;
+
+uint8_t TM1637Font::glyph(char c)
+{
+	uint8_t code = c; // plain char may be signed, bytes >= 0x80 would come out negative
+	return code >= FIRST && code <= LAST ? pgm_read_byte(&segments[code - FIRST]) : 0;
+}
+
 TM1637Display::TM1637Display(uint8_t pinClk, uint8_t pinDIO, unsigned int bitDelay)
 {
 	// Copy the pin numbers
 	m_pinClk = pinClk;
 	m_pinDIO = pinDIO;
 	m_bitDelay = bitDelay;
+	m_brightness = 0x0f;
+
+	// The display RAM is undefined after power up: send everything with the first flush
+	memset(m_frame, 0, sizeof(m_frame));
+	m_dirty = 0x0f;
+	m_controlDirty = true;
 
 	// Set the pin direction and default value.
 	// Both pins are set as inputs, allowing the pull-up resistors to pull them up
@@ -75,30 +73,74 @@ TM1637Display::TM1637Display(uint8_t pinClk, uint8_t pinDIO, unsigned int bitDel
 
 void TM1637Display::setBrightness(uint8_t brightness, bool on)
 {
-	m_brightness = (brightness & 0x7) | (on? 0x08 : 0x00);
+	uint8_t value = (brightness & 0x7) | (on? 0x08 : 0x00);
+	if (value != m_brightness) {
+		m_brightness = value;
+		m_controlDirty = true;
+	}
 }
 
 void TM1637Display::setSegments(const uint8_t segments[], uint8_t length, uint8_t pos)
 {
-    // Write COMM1
-	start();
-	writeByte(TM1637_I2C_COMM1);
-	stop();
+	for (uint8_t k=0; k < length && pos + k < 4; k++) {
+		if (m_frame[pos + k] != segments[k]) {
+			m_frame[pos + k] = segments[k];
+			m_dirty |= 1 << (pos + k);
+		}
+	}
+}
 
-	// Write COMM2 + first digit address
-	start();
-	writeByte(TM1637_I2C_COMM2 + (pos & 0x03));
+uint8_t TM1637Display::takeChanges(uint8_t bytes[], uint8_t& lasts)
+{
+	uint8_t length = 0;
+	lasts = 0;
 
-	// Write the data bytes
-	for (uint8_t k=0; k < length; k++)
-	  writeByte(segments[k]);
+	if (m_controlDirty) {
+		// COMM1: auto-increment mode, the module keeps it
+		bytes[length] = TM1637_I2C_COMM1;
+		lasts |= 1 << length++;
+	}
 
-	stop();
+	if (m_dirty != 0) {
+		uint8_t first = 0;
+		while (!(m_dirty & (1 << first)))
+			first++;
+		uint8_t last = 3;
+		while (!(m_dirty & (1 << last)))
+			last--;
+
+		// COMM2 + first changed digit, then the data bytes up to the last changed one
+		bytes[length++] = TM1637_I2C_COMM2 + first;
+		for (uint8_t k=first; k <= last; k++)
+			bytes[length++] = m_frame[k];
+		lasts |= 1 << (length - 1);
+		m_dirty = 0;
+	}
+
+	if (m_controlDirty) {
+		// COMM3 + brightness
+		bytes[length] = TM1637_I2C_COMM3 + (m_brightness & 0x0f);
+		lasts |= 1 << length++;
+		m_controlDirty = false;
+	}
+	return length;
+}
 
-	// Write COMM3 + brightness
-	start();
-	writeByte(TM1637_I2C_COMM3 + (m_brightness & 0x0f));
-	stop();
+void TM1637Display::flush()
+{
+	uint8_t bytes[TM1637_MAX_SEQUENCE];
+	uint8_t lasts;
+	uint8_t length = takeChanges(bytes, lasts);
+
+	bool first = true;
+	for (uint8_t k=0; k < length; k++) {
+		if (first)
+			start();
+		writeByte(bytes[k]);
+		first = lasts & (1 << k);
+		if (first)
+			stop();
+	}
 }
 
 void TM1637Display::clear()
@@ -254,5 +296,22 @@ void TM1637Display::showDots(uint8_t dots, uint8_t* digits)
 
 uint8_t TM1637Display::encodeDigit(uint8_t digit)
 {
-	return digitToSegment[digit & 0x0f];
+	digit &= 0x0f;
+	return TM1637Font::glyph(digit < 10 ? '0' + digit : 'A' + digit - 10);
+}
+
+void TM1637Display::showText(const char* text)
+{
+	uint8_t digits[] = { 0, 0, 0, 0 };
+	int8_t pos = -1;
+	for (; *text; text++) {
+		if (*text == '.' && pos >= 0 && !(digits[pos] & SEG_DP)) {
+			digits[pos] |= SEG_DP;
+			continue;
+		}
+		if (++pos >= 4)
+			break;
+		digits[pos] = TM1637Font::glyph(*text);
+	}
+	setSegments(digits);
 }
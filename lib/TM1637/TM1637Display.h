@@ -18,6 +18,7 @@
 #define __TM1637DISPLAY__
 
 #include <inttypes.h>
+#include <FastPin.h>
 
 #define SEG_A   0b00000001
 #define SEG_B   0b00000010
@@ -28,8 +29,146 @@
 #define SEG_G   0b01000000
 #define SEG_DP  0b10000000
 
+//! Font: the segments of the printable ASCII characters 0x20 - 0x7F
+//!
+//! Letters are the usual 7 segment approximations, both cases map to whatever shape
+//! reads best (e.g. 'b', 'd', 'r', 't'). '*' is the degree sign, '.' the decimal point.
+//! Characters a 7 segment digit can't show are blank.
+//!
+//! The table is a constexpr member so texts can be encoded at compile time (tm1637Text()).
+//! Its one definition, in TM1637Display.cpp, is in PROGMEM: at run time use glyph().
+struct TM1637Font {
+  static constexpr uint8_t FIRST = ' ';
+  static constexpr uint8_t LAST = 0x7F;
+  static constexpr uint8_t segments[LAST - FIRST + 1] = {
+   // XGFEDCBA
+    0b00000000,    // ' '
+    0b00000000,    // '!'
+    0b00100010,    // '"'
+    0b00000000,    // '#'
+    0b00000000,    // '$'
+    0b00000000,    // '%'
+    0b00000000,    // '&'
+    0b00000010,    // '''
+    0b00111001,    // '('
+    0b00001111,    // ')'
+    0b01100011,    // '*' degree
+    0b00000000,    // '+'
+    0b00000000,    // ','
+    0b01000000,    // '-'
+    0b10000000,    // '.'
+    0b01010010,    // '/'
+    0b00111111,    // 0
+    0b00000110,    // 1
+    0b01011011,    // 2
+    0b01001111,    // 3
+    0b01100110,    // 4
+    0b01101101,    // 5
+    0b01111101,    // 6
+    0b00000111,    // 7
+    0b01111111,    // 8
+    0b01101111,    // 9
+    0b00000000,    // ':'
+    0b00000000,    // ';'
+    0b00000000,    // '<'
+    0b01001000,    // '='
+    0b00000000,    // '>'
+    0b01010011,    // '?'
+    0b00000000,    // '@'
+    0b01110111,    // A
+    0b01111100,    // b
+    0b00111001,    // C
+    0b01011110,    // d
+    0b01111001,    // E
+    0b01110001,    // F
+    0b00111101,    // G
+    0b01110110,    // H
+    0b00000110,    // I
+    0b00011110,    // J
+    0b01110101,    // K
+    0b00111000,    // L
+    0b00110111,    // M
+    0b00110111,    // N
+    0b00111111,    // O
+    0b01110011,    // P
+    0b01100111,    // q
+    0b01010000,    // r
+    0b01101101,    // S
+    0b01111000,    // t
+    0b00111110,    // U
+    0b00111110,    // V
+    0b00111110,    // W
+    0b01110110,    // X
+    0b01101110,    // y
+    0b01011011,    // Z
+    0b00111001,    // '['
+    0b01100100,    // '\'
+    0b00001111,    // ']'
+    0b00100011,    // '^'
+    0b00001000,    // '_'
+    0b00100000,    // '`'
+    0b01011111,    // a
+    0b01111100,    // b
+    0b01011000,    // c
+    0b01011110,    // d
+    0b01111011,    // e
+    0b01110001,    // f
+    0b01101111,    // g
+    0b01110100,    // h
+    0b00000100,    // i
+    0b00001110,    // j
+    0b01110101,    // k
+    0b00110000,    // l
+    0b01010100,    // m
+    0b01010100,    // n
+    0b01011100,    // o
+    0b01110011,    // p
+    0b01100111,    // q
+    0b01010000,    // r
+    0b01101101,    // s
+    0b01111000,    // t
+    0b00011100,    // u
+    0b00011100,    // v
+    0b00011100,    // w
+    0b01110110,    // x
+    0b01101110,    // y
+    0b01011011,    // z
+    0b00111001,    // '{'
+    0b00110000,    // '|'
+    0b00001111,    // '}'
+    0b00000001,    // '~'
+    0b00000000     // DEL
+    };
+
+  //! Segments of one character at run time, read from PROGMEM
+  static uint8_t glyph(char c);
+};
+
+//! Segments of one character, at compile time
+constexpr uint8_t tm1637Glyph(char c)
+{
+  return (uint8_t)c >= TM1637Font::FIRST && (uint8_t)c <= TM1637Font::LAST ? TM1637Font::segments[(uint8_t)c - TM1637Font::FIRST] : 0;
+}
+
+//! Four digits worth of segments
+struct TM1637Text {
+  uint8_t segments[4];
+};
+
+//! Encodes a text of exactly four characters at compile time
+//!
+//! Only use it to initialize constexpr constants or PROGMEM tables: evaluated at run time
+//! it would read the font from the wrong address space.
+constexpr TM1637Text tm1637Text(const char (&text)[5])
+{
+  return {{ tm1637Glyph(text[0]), tm1637Glyph(text[1]), tm1637Glyph(text[2]), tm1637Glyph(text[3]) }};
+}
+
 #define DEFAULT_BIT_DELAY  100
 
+// Longest command/data sequence of one flush: data command, address + 4 digits, display control
+#define TM1637_MAX_SEQUENCE 7
+
 class TM1637Display {
 
 public:
@@ -44,8 +183,7 @@ public:
 
   //! Sets the brightness of the display.
   //!
-  //! The setting takes effect when a command is given to change the data being
-  //! displayed.
+  //! The setting takes effect with the next flush().
   //!
   //! @param brightness A number from 0 (lowes brightness) to 7 (highest brightness)
   //! @param on Turn display on or off
@@ -53,7 +191,9 @@ public:
 
   //! Display arbitrary data on the module
   //!
-  //! This function receives raw segment values as input and displays them. The segment data
+  //! This function receives raw segment values as input and writes them to the framebuffer,
+  //! flush() sends them to the module. Like all functions that show something, it doesn't
+  //! touch the bus itself. The segment data
   //! is given as a byte array, each byte corresponding to a single digit. Within each byte,
   //! bit 0 is segment A, bit 1 is segment B etc.
   //! The function may either set the entire display or any desirable part on its own. The first
@@ -65,6 +205,26 @@ public:
   //! @param pos The position from which to start the modification (0 - leftmost, 3 - rightmost)
   void setSegments(const uint8_t segments[], uint8_t length = 4, uint8_t pos = 0);
 
+  //! Display a text encoded at compile time with tm1637Text(), all four digits at once
+  //!
+  //! @param text The encoded text, passed by value so it never needs to be kept in RAM
+  void showText(TM1637Text text) { setSegments(text.segments); }
+
+  //! Display a text encoded at run time
+  //!
+  //! The characters are looked up in TM1637Font, a '.' lights the decimal point of the
+  //! character before it. Digits after the end of the text are blank.
+  //!
+  //! @param text The text, up to four characters plus decimal points
+  void showText(const char* text);
+
+  //! Send the changes to the module
+  //!
+  //! Only the digits that changed since the last flush are sent, from the first to the last
+  //! changed one in a single auto-increment transaction. The display control command follows only
+  //! if the brightness changed. Without changes nothing is sent.
+  virtual void flush();
+
   //! Clear the display
   void clear();
 
@@ -145,12 +305,19 @@ public:
 protected:
    void bitDelay();
 
+   unsigned int bitDelayMicros() { return m_bitDelay; }
+
    void start();
 
    void stop();
 
    bool writeByte(uint8_t b);
 
+   //! Takes the pending changes for sending: the bytes go to @ref bytes (at most
+   //! TM1637_MAX_SEQUENCE), bit n of @ref lasts marks byte n as the last one of a
+   //! transaction. Returns the number of bytes, 0 if nothing changed
+   uint8_t takeChanges(uint8_t bytes[], uint8_t& lasts);
+
    void showDots(uint8_t dots, uint8_t* digits);
    
    void showNumberBaseEx(int8_t base, uint16_t num, uint8_t dots = 0, bool leading_zero = false, uint8_t length = 4, uint8_t pos = 0);
@@ -161,6 +328,164 @@ private:
 	uint8_t m_pinDIO;
 	uint8_t m_brightness;
 	unsigned int m_bitDelay;
+	uint8_t m_frame[4];           // segments as the module should show them
+	uint8_t m_dirty;              // bit n: digit n differs from the module
+	bool m_controlDirty;          // brightness changed, or nothing was sent yet
 };
 
+#if defined(__AVR_ATmega328P__)
+// Timer2 compare interrupt of the bus engine, calls the engine of the active display
+extern void (*volatile tm1637Tick)();
+#endif
+
+//! TM1637Display with the pins fixed at compile time and an interrupt driven bus
+//!
+//! flush() only copies the changes into a queue and returns. A Timer2 compare interrupt
+//! clocks them out, one bus phase (one pin edge) per tick of bitDelay microseconds, so a
+//! display update never holds up the main loop. The bus is driven through FastPin, every
+//! edge is a single instruction. While a sequence is still being sent, flush() leaves the
+//! new changes in the framebuffer for the next call.
+//!
+//! Timer2 is taken over: no tone(), and no analogWrite() on pins 3 and 11. In the native
+//! build there is no timer, the same engine is stepped through right away by flush().
+//!
+//! @tparam pinClk - The number of the digital pin connected to the clock pin of the module
+//! @tparam pinDIO - The number of the digital pin connected to the DIO pin of the module
+template <uint8_t pinClk, uint8_t pinDIO>
+class FastTM1637Display : public TM1637Display {
+
+public:
+  FastTM1637Display(unsigned int bitDelay = DEFAULT_BIT_DELAY) : TM1637Display(pinClk, pinDIO, bitDelay) {}
+
+  void flush() override
+  {
+    if (busy())
+      return;
+    uint8_t lasts;
+    uint8_t length = takeChanges(s_bytes, lasts);
+    if (length == 0)
+      return;
+    s_lasts = lasts;
+    s_length = length;
+    s_index = 0;
+    s_phase = PHASE_START;
+#if defined(__AVR_ATmega328P__)
+    // Timer2 is set up here rather than in the constructor, init() of the core reconfigures it
+    if (tm1637Tick != tick) {
+      TIMSK2 = 0;
+      TCCR2A = _BV(WGM21);                    // CTC, TOP = OCR2A
+      TCCR2B = _BV(CS22);                     // 16 MHz / 64: 4 us per count
+      OCR2A = constrain(bitDelayMicros() / 4, 2, 256) - 1;
+      tm1637Tick = tick;
+    }
+    asm volatile("" ::: "memory"); // the queue is complete before the interrupt sees it
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A);
+    TIMSK2 = _BV(OCIE2A);
+#else
+    while (busy()) {
+      tick();
+      bitDelay();
+    }
+#endif
+  }
+
+  //! True while a sequence is being sent
+  static bool busy() { return s_phase != PHASE_IDLE; }
+
+protected:
+  typedef FastPin<pinClk> Clk;
+  typedef FastPin<pinDIO> Dio;
+
+  enum Phase : uint8_t {
+    PHASE_IDLE, PHASE_START, PHASE_CLK_LOW, PHASE_DATA, PHASE_CLK_HIGH,
+    PHASE_ACK_CLK_LOW, PHASE_ACK_CLK_HIGH, PHASE_ACK_READ, PHASE_ACK_END,
+    PHASE_STOP_DIO_LOW, PHASE_STOP_CLK_HIGH, PHASE_STOP_DIO_HIGH
+  };
+
+  static uint8_t s_bytes[TM1637_MAX_SEQUENCE];
+  static uint8_t s_lasts;
+  static uint8_t s_length;
+  static uint8_t s_index;
+  static uint8_t s_bit;
+  static volatile uint8_t s_phase;
+
+  // One phase of the bus, the same sequence of edges as start() / writeByte() / stop()
+  static void tick()
+  {
+    switch (s_phase) {
+      case PHASE_START:
+        Dio::output();
+        s_bit = 0;
+        s_phase = PHASE_CLK_LOW;
+        break;
+      case PHASE_CLK_LOW:
+        Clk::output();
+        s_phase = PHASE_DATA;
+        break;
+      case PHASE_DATA:
+        if (s_bytes[s_index] & (1 << s_bit))
+          Dio::input();
+        else
+          Dio::output();
+        s_phase = PHASE_CLK_HIGH;
+        break;
+      case PHASE_CLK_HIGH:
+        Clk::input();
+        s_phase = ++s_bit < 8 ? PHASE_CLK_LOW : PHASE_ACK_CLK_LOW;
+        break;
+      case PHASE_ACK_CLK_LOW:
+        Clk::output();
+        Dio::input();
+        s_phase = PHASE_ACK_CLK_HIGH;
+        break;
+      case PHASE_ACK_CLK_HIGH:
+        Clk::input();
+        s_phase = PHASE_ACK_READ;
+        break;
+      case PHASE_ACK_READ:
+        if (!Dio::read())
+          Dio::output();
+        s_phase = PHASE_ACK_END;
+        break;
+      case PHASE_ACK_END:
+        Clk::output();
+        if (s_lasts & (1 << s_index)) {
+          s_phase = PHASE_STOP_DIO_LOW;
+        }
+        else {
+          s_bit = 0;
+          s_phase = PHASE_CLK_LOW;
+        }
+        s_index++;
+        break;
+      case PHASE_STOP_DIO_LOW:
+        Dio::output();
+        s_phase = PHASE_STOP_CLK_HIGH;
+        break;
+      case PHASE_STOP_CLK_HIGH:
+        Clk::input();
+        s_phase = PHASE_STOP_DIO_HIGH;
+        break;
+      case PHASE_STOP_DIO_HIGH:
+        Dio::input();
+        s_phase = s_index < s_length ? PHASE_START : PHASE_IDLE;
+#if defined(__AVR_ATmega328P__)
+        if (s_phase == PHASE_IDLE)
+          TIMSK2 = 0;
+#endif
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+template <uint8_t pinClk, uint8_t pinDIO> uint8_t FastTM1637Display<pinClk, pinDIO>::s_bytes[TM1637_MAX_SEQUENCE];
+template <uint8_t pinClk, uint8_t pinDIO> uint8_t FastTM1637Display<pinClk, pinDIO>::s_lasts;
+template <uint8_t pinClk, uint8_t pinDIO> uint8_t FastTM1637Display<pinClk, pinDIO>::s_length;
+template <uint8_t pinClk, uint8_t pinDIO> uint8_t FastTM1637Display<pinClk, pinDIO>::s_index;
+template <uint8_t pinClk, uint8_t pinDIO> uint8_t FastTM1637Display<pinClk, pinDIO>::s_bit;
+template <uint8_t pinClk, uint8_t pinDIO> volatile uint8_t FastTM1637Display<pinClk, pinDIO>::s_phase = PHASE_IDLE;
+
 #endif // __TM1637DISPLAY__
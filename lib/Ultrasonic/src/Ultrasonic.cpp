@@ -15,6 +15,11 @@
  * by Erick Simões (github: @ErickSimoes | twitter: @AloErickSimoes)
  * modified 14 Jun 2018
  * by Otacilio Maia (github: @OtacilioN | linkedIn: in/otacilio)
+ * modified for the motorized IKEA Skarsta desk
+ * asynchronous ranging: startPing() / ready() / poll()
+ * high resolution: readMicros() / readMillimetres() / pollMicros() / pollMillimetres()
+ * temperature compensation: setTemperature()
+ * pins fixed at compile time: FastUltrasonic
  *
  * Released into the MIT License.
  */
@@ -25,8 +30,11 @@
   #include <WProgram.h>
 #endif
 
+#include <PinChange.h>
 #include "Ultrasonic.h"
 
+Ultrasonic* volatile Ultrasonic::pinging = 0;
+
 Ultrasonic::Ultrasonic(uint8_t trigPin, uint8_t echoPin, unsigned long timeOut) {
   trig = trigPin;
   echo = echoPin;
@@ -36,7 +44,7 @@ Ultrasonic::Ultrasonic(uint8_t trigPin, uint8_t echoPin, unsigned long timeOut)
   timeout = timeOut;
 }
 
-unsigned int Ultrasonic::timing() {
+void Ultrasonic::trigger() {
   if (threePins)
     pinMode(trig, OUTPUT);
 
@@ -48,15 +56,119 @@ unsigned int Ultrasonic::timing() {
 
   if (threePins)
     pinMode(trig, INPUT);
-  
+}
+
+bool Ultrasonic::echoHigh() {
+  return digitalRead(echo);
+}
+
+unsigned int Ultrasonic::timing() {
+  trigger();
+
   previousMicros = micros();
-  while(!digitalRead(echo) && (micros() - previousMicros) <= timeout); // wait for the echo pin HIGH or timeout
+  while(!echoHigh() && (micros() - previousMicros) <= timeout); // wait for the echo pin HIGH or timeout
   previousMicros = micros();
-  while(digitalRead(echo)  && (micros() - previousMicros) <= timeout); // wait for the echo pin LOW or timeout
+  while(echoHigh()  && (micros() - previousMicros) <= timeout); // wait for the echo pin LOW or timeout
 
   return micros() - previousMicros; // duration
 }
 
+/*
+ * Fires the trigger and returns immediately, the echo is measured in the background.
+ * A ping still in flight is abandoned.
+ */
+void Ultrasonic::startPing() {
+  if (!echoAttached) {
+    attachPinChange(echo, echoChanged);
+    echoAttached = true;
+  }
+
+  pingState = PING_IDLE;
+  pinging = this;
+  trigger();
+
+  noInterrupts();
+  previousMicros = micros();
+  echoDuration = 0;
+  pingState = PING_WAIT_ECHO;
+  interrupts();
+}
+
+/*
+ * Echo pin interrupt. The level tells which edge it was, so stray
+ * interrupts (e.g. from the trigger of a three pin sensor) are harmless.
+ */
+void Ultrasonic::echoChanged() {
+  Ultrasonic* sensor = pinging;
+  if (sensor == 0)
+    return;
+
+  unsigned long now = micros();
+  if (sensor->echoHigh()) {
+    if (sensor->pingState == PING_WAIT_ECHO) {
+      sensor->echoStart = now;
+      sensor->pingState = PING_ECHO;
+    }
+  }
+  else if (sensor->pingState == PING_ECHO) {
+    sensor->echoDuration = now - sensor->echoStart;
+    sensor->pingState = PING_DONE;
+  }
+}
+
+/*
+ * True once the echo of the last startPing() is over. A timeout measures 0, whether no echo
+ * started or it didn't end in time: a sensor that hears nothing holds its echo pin high for
+ * its own ~38 ms, that is no distance.
+ */
+bool Ultrasonic::ready() {
+  noInterrupts();
+  uint8_t state = pingState;
+  unsigned long since = state == PING_ECHO ? echoStart : previousMicros;
+  interrupts();
+
+  if (state == PING_DONE)
+    return true;
+  if (state == PING_IDLE || (micros() - since) <= timeout)
+    return false;
+
+  noInterrupts();
+  if (pingState == state) {
+    echoDuration = 0;
+    pingState = PING_DONE;
+  }
+  interrupts();
+  return true;
+}
+
+/*
+ * Echo duration of the last completed ping in microseconds, 0 if none is ready.
+ */
+unsigned long Ultrasonic::pollMicros() {
+  if (!ready())
+    return 0;
+
+  noInterrupts();
+  unsigned long duration = echoDuration;
+  pingState = PING_IDLE;
+  interrupts();
+  if (pinging == this)
+    pinging = 0;
+
+  return duration;
+}
+
+/*
+ * Distance measured by the last completed ping, 0 if none is ready.
+ */
+unsigned int Ultrasonic::poll(uint8_t und) {
+  return pollMicros() / und / 2;  //distance by divisor
+}
+
+unsigned int Ultrasonic::pollMillimetres() {
+  return toMillimetres(pollMicros());
+}
+
 /*
  * If the unit of measure is not passed as a parameter,
  * sby default, it will return the distance in centimeters.
@@ -66,6 +178,29 @@ unsigned int Ultrasonic::read(uint8_t und) {
   return timing() / und / 2;  //distance by divisor
 }
 
+/*
+ * Raw echo duration in microseconds, and the distance in millimetres
+ * from it without the rounding to whole units of read().
+ */
+unsigned long Ultrasonic::readMicros() {
+  return timing();
+}
+
+unsigned int Ultrasonic::readMillimetres() {
+  return toMillimetres(timing());
+}
+
+/*
+ * The factor is only recomputed when the temperature changes,
+ * converting a reading stays a multiply and a shift.
+ */
+void Ultrasonic::setTemperature(int deciCelsius) {
+  if (deciCelsius == temperature)
+    return;
+  temperature = deciCelsius;
+  mmFactor = MM_FACTOR * SOUND_SPEED(deciCelsius) / SOUND_SPEED(REFERENCE_TEMPERATURE);
+}
+
 /*
  * This method is too verbal, so, it's deprecated.
  * Use read() instead.
@@ -13,6 +13,11 @@
  * by Eliot Lim    (github: @eliotlim)
  * modified 10 Jun 2018
  * by Erick Simões (github: @ErickSimoes | twitter: @AloErickSimoes)
+ * modified for the motorized IKEA Skarsta desk
+ * asynchronous ranging: startPing() / ready() / poll()
+ * high resolution: readMicros() / readMillimetres() / pollMicros() / pollMillimetres()
+ * temperature compensation: setTemperature()
+ * pins fixed at compile time: FastUltrasonic
  *
  * Released into the MIT License.
  */
@@ -20,19 +25,65 @@
 #ifndef Ultrasonic_h
 #define Ultrasonic_h
 
+#include <FastPin.h>
+
 /*
  * Values of divisors
  */
 #define CM 28
 #define INC 71
 
+/*
+ * Millimetres per microsecond of echo, in 1/2^MM_SHIFT, matching the CM divisor.
+ * The conversion is a multiply and a shift, for echoes up to about 360 ms.
+ */
+#define MM_SHIFT 16
+#define MM_FACTOR ((10UL << MM_SHIFT) / (2 * CM))
+
+/*
+ * The speed of sound grows by 0.606 m/s per degree, 331.3 m/s at 0 degrees.
+ * The divisors are taken to be right at REFERENCE_TEMPERATURE (1/10 degrees),
+ * setTemperature() scales the millimetre factor from there.
+ */
+#define REFERENCE_TEMPERATURE 200
+#define SOUND_SPEED(deciCelsius) (3313L + 606L * (deciCelsius) / 1000) // 1/10 m/s
+
 class Ultrasonic {
   public:
     Ultrasonic(uint8_t sigPin) : Ultrasonic(sigPin, sigPin) {};
     Ultrasonic(uint8_t trigPin, uint8_t echoPin, unsigned long timeOut = 20000UL);
     unsigned int read(uint8_t und = CM);
     unsigned int distanceRead(uint8_t und = CM) __attribute__ ((deprecated ("This method is deprecated, use read() instead.")));
+    unsigned long readMicros();
+    unsigned int readMillimetres();
+    // Air temperature in 1/10 degrees for the millimetre readings
+    void setTemperature(int deciCelsius);
     void setTimeout(unsigned long timeOut) {timeout = timeOut;}
+    // Timeout for echoes from up to millimetres away, at the current temperature
+    void setMaxDistance(unsigned int millimetres) {
+      timeout = ((unsigned long)millimetres << MM_SHIFT) / mmFactor;
+    }
+
+    /*
+     * Asynchronous ranging. startPing() fires the trigger and returns, the echo edges are
+     * timestamped by a pin change interrupt. ready() turns true once the echo is over (or timed out),
+     * poll() then returns the distance the same way read() does, pollMicros() and pollMillimetres()
+     * like their read counterparts. A ping that timed out returns 0.
+     * Only one sensor can have a ping in flight at a time.
+     */
+    void startPing();
+    bool ready();
+    unsigned int poll(uint8_t und = CM);
+    unsigned long pollMicros();
+    unsigned int pollMillimetres();
+
+    unsigned int toMillimetres(unsigned long duration) {
+      return duration * mmFactor >> MM_SHIFT;
+    }
+
+  protected:
+    virtual void trigger();
+    virtual bool echoHigh();
 
   private:
     uint8_t trig;
@@ -40,7 +91,47 @@ class Ultrasonic {
     boolean threePins = false;
     unsigned long previousMicros;
     unsigned long timeout;
+    int temperature = REFERENCE_TEMPERATURE;
+    unsigned long mmFactor = MM_FACTOR;
     unsigned int timing();
+
+    enum PingState : uint8_t { PING_IDLE, PING_WAIT_ECHO, PING_ECHO, PING_DONE };
+    volatile uint8_t pingState = PING_IDLE;
+    volatile unsigned long echoStart;
+    volatile unsigned long echoDuration;
+    boolean echoAttached = false;
+    static Ultrasonic* volatile pinging;
+    static void echoChanged();
+};
+
+/*
+ * Ultrasonic with the pins fixed at compile time. The trigger pulse and the echo
+ * pin reads (also the one in the echo interrupt) go through FastPin instead of
+ * digitalWrite() / digitalRead().
+ */
+template <uint8_t trigPin, uint8_t echoPin>
+class FastUltrasonic : public Ultrasonic {
+  public:
+    FastUltrasonic(unsigned long timeOut = 20000UL) : Ultrasonic(trigPin, echoPin, timeOut) {}
+
+  protected:
+    void trigger() override {
+      if (trigPin == echoPin)
+        FastPin<trigPin>::output();
+
+      FastPin<trigPin>::low();
+      delayMicroseconds(2);
+      FastPin<trigPin>::high();
+      delayMicroseconds(10);
+      FastPin<trigPin>::low();
+
+      if (trigPin == echoPin)
+        FastPin<trigPin>::input();
+    }
+
+    bool echoHigh() override {
+      return FastPin<echoPin>::read();
+    }
 };
 
 #endif // Ultrasonic_h
@@ -0,0 +1,40 @@
+/*
+  Animation.cpp
+
+  See Animation.h
+*/
+#include "Animation.h"
+
+bool Animator::play(const Animation* animation) {
+  Animation header;
+  memcpy_P(&header, animation, sizeof(header));
+  if (current != NULL && header.priority < priority)
+    return false;
+  current = header.frames;
+  priority = header.priority;
+  return true;
+}
+
+unsigned long Animator::step() {
+  if (current == NULL)
+    return 0;
+
+  Keyframe frame;
+  memcpy_P(&frame, current, sizeof(frame));
+  if (frame.action != 0) {
+    renderer(frame.action);
+  }
+  else {
+    for (uint8_t digit = 0; digit < 4; digit++) {
+      if (frame.digits & (1 << digit))
+        display.setSegments(&frame.text.segments[digit], 1, digit);
+    }
+  }
+
+  if (frame.hold == 0) {
+    current = NULL;
+    return 0;
+  }
+  current++;
+  return frame.hold;
+}
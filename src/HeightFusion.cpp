@@ -0,0 +1,39 @@
+/*
+  HeightFusion.cpp
+
+  See HeightFusion.h
+*/
+#include "HeightFusion.h"
+
+//Encoder counts to um. Split to stay within 32 bits over the whole travel of the desk
+static long travel(long counts, long countsPerCm) {
+  return counts / countsPerCm * 10000 + counts % countsPerCm * 10000 / countsPerCm;
+}
+
+void HeightFusion::sonar(long heightUm, long counts) {
+  if (heightUm == 0)
+    return;
+
+  long error = heightUm - height(counts);
+  if (!anchored || abs(error) > REANCHOR_DISTANCE) {
+    //The desk moved that far without a single count: the encoders aren't connected
+    if (anchored && counts == lastCounts)
+      encodersLost = true;
+    offset = heightUm - travel(counts, countsPerCm);
+    anchored = true;
+  }
+  else
+    offset += error / FUSION_GAIN;
+  if (counts != lastCounts)
+    encodersLost = false;
+  lastCounts = counts;
+  lastSonar = heightUm;
+}
+
+long HeightFusion::height(long counts) {
+  if (!anchored)
+    return 0;
+  if (encodersLost)
+    return lastSonar;
+  return offset + travel(counts, countsPerCm);
+}
@@ -0,0 +1,78 @@
+/*
+  HeightKalman.cpp
+
+  See HeightKalman.h
+*/
+#include "HeightKalman.h"
+
+//Covariances never grow past this, e.g. while the sonar is out (units^2, about 10 cm and 5 cm/s)
+const long MAX_HEIGHT_VARIANCE = 100000000L;
+const long MAX_VELOCITY_VARIANCE = 25000000L;
+//Velocity uncertainty of a fresh estimate, units^2/s^2 (3 cm/s)
+const long START_VELOCITY_VARIANCE = 9000000L;
+
+HeightKalman::HeightKalman(long measurementNoise) {
+  long noise = measurementNoise / KALMAN_UNIT;
+  r = noise * noise;
+}
+
+void HeightKalman::predict(int newDuty, unsigned long now) {
+  long dt = now - at;
+  if (dt > 1000)
+    dt = 1000; //the desk doesn't move unpowered, a long gap only makes the estimate less certain
+  at = now;
+  int lastDuty = duty;
+  duty = newDuty; //applies from now on, the last one drove the desk until now
+  if (!started || dt <= 0)
+    return;
+
+  //Height moves with the velocity, the velocity follows the duty (control input)
+  long target = (long)lastDuty * (lastDuty >= 0 ? speedUp : speedDown) / MOTOR_DUTY_MAX;
+  h += v * dt / 1000;
+  v += (target - v) * dt / (KALMAN_TAU + dt);
+
+  //P = F P F' + Q with F = [1 dt; 0 1]
+  p00 += ((int64_t)2 * p01 * dt + (int64_t)p11 * dt * dt / 1000) / 1000 + KALMAN_HEIGHT_NOISE * KALMAN_HEIGHT_NOISE * dt / 1000;
+  p01 += (int64_t)p11 * dt / 1000;
+  p11 += KALMAN_VELOCITY_NOISE * KALMAN_VELOCITY_NOISE * dt / 1000;
+  p00 = min(p00, MAX_HEIGHT_VARIANCE);
+  p11 = min(p11, MAX_VELOCITY_VARIANCE);
+  p01 = constrain(p01, -MAX_VELOCITY_VARIANCE, MAX_VELOCITY_VARIANCE);
+}
+
+void HeightKalman::update(long heightUm, unsigned long now) {
+  if (heightUm == 0)
+    return;
+  if (!started) {
+    h = heightUm;
+    v = 0;
+    p00 = r;
+    p01 = 0;
+    p11 = START_VELOCITY_VARIANCE;
+    at = now;
+    started = true;
+    return;
+  }
+  predict(duty, now);
+
+  //Gains in 1/1024: height per height error and velocity (1/s) per height error
+  long s = p00 + r;
+  long k0 = (int64_t)p00 * 1024 / s;
+  long k1 = (int64_t)p01 * 1024 / s;
+  long innovation = heightUm - h;
+  h += (int64_t)k0 * innovation >> 10;
+  v += (int64_t)k1 * innovation >> 10;
+
+  //P = (I - K H) P
+  long q01 = p01;
+  p11 -= (int64_t)k1 * q01 >> 10;
+  p01 -= (int64_t)k0 * q01 >> 10;
+  p00 -= (int64_t)k0 * p00 >> 10;
+
+  //Learn how fast the desk goes per duty while it cruises in the commanded direction
+  if (abs(duty) >= KALMAN_LEARN_DUTY && (v > 0) == (duty > 0)) {
+    long &speed = duty > 0 ? speedUp : speedDown;
+    long observed = abs(v) * MOTOR_DUTY_MAX / abs(duty);
+    speed += (observed - speed) / 16;
+  }
+}
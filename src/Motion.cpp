@@ -0,0 +1,212 @@
+/*
+  Motion.cpp
+
+  See Motion.h
+*/
+#include "Motion.h"
+#include "Motor.h"
+
+const int APPROACH_DISTANCE = 50;  //mm before the target where the height controller takes over
+const int DEADBAND = 3;            //mm, the desk has arrived within +-DEADBAND of the target
+const int CONTROL_INTERVAL = 20;   //ms between two controller updates, the estimator delivers the height at any time
+const int COAST_DEFAULT = 150;     //ms the desk keeps going after the motors are told to stop, until learned
+const int COAST_MAX = 1000;
+const int COAST_LEARN_RATE = 4;    //every stop moves the coast time 1/COAST_LEARN_RATE of the way to the one measured
+const int COAST_MIN_SPEED = 5;     //mm/s, a slower stop is too short to measure the coast time from
+const int SETTLE_TIME = 500;       //ms the desk gets to come to rest before the height is checked
+const int MAX_CORRECTIONS = 2;     //times the controller takes over again when the desk came to rest outside the deadband
+const unsigned long APPROACH_TIMEOUT = 10000; //ms, gives up on the deadband after this long
+
+//Height controller: duty per mm of error (1/100), the D part acts on the estimated velocity (mm/s)
+const int KP = 1600;
+const int KI = 600;
+const int KD = 0;
+//Duty that just about gets the loaded desk moving, added to the controller output so small errors still move it.
+//Going down gravity helps. The integral makes up for heavier loads
+const int BREAKAWAY_PWM_UP = 280;
+const int BREAKAWAY_PWM_DOWN = 120;
+
+const Motion::Handler Motion::handlers[MOTION_STATE_COUNT] = {
+  &Motion::idle,      //MOTION_IDLE
+  &Motion::rampUp,    //MOTION_RAMP_UP
+  &Motion::cruise,    //MOTION_CRUISE
+  &Motion::approach,  //MOTION_APPROACH
+  &Motion::settle,    //MOTION_SETTLE
+  &Motion::fault      //MOTION_FAULT
+};
+
+Motion::Motion() : pid(KP, KI, KD, MOTOR_DUTY_MAX), coastUp(COAST_DEFAULT), coastDown(COAST_DEFAULT) {
+}
+
+void Motion::setCoastTime(int8_t direction, int ms) {
+  ms = constrain(ms, 0, COAST_MAX);
+  if (direction > 0)
+    coastUp = ms;
+  else
+    coastDown = ms;
+}
+
+void Motion::begin(MotionCallback finished) {
+  callback = finished;
+}
+
+bool Motion::start(int target, int height) {
+  if (height == 0 || target == height)
+    return false;
+
+  targetHeight = target;
+  dir = target > height ? 1 : -1;
+  corrections = 0;
+  missed = false;
+  current = MOTION_RAMP_UP;
+  enteredAt = millis();
+  return true;
+}
+
+void Motion::cancel() {
+  if (current == MOTION_IDLE)
+    return;
+  stopMoving();
+  current = MOTION_IDLE;
+  if (callback)
+    callback(MOTION_CANCELLED);
+}
+
+void Motion::step(int height, int velocity) {
+  if (current == MOTION_IDLE)
+    return;
+  speed = velocity;
+
+  MotionState next;
+  if (height == 0 && current < MOTION_SETTLE) { //Sonar error while the desk is moving
+    haltMotors();
+    next = MOTION_FAULT;
+  }
+  else
+    next = (this->*handlers[current])(height);
+  if (next == current)
+    return;
+
+  MotionState last = current;
+  current = next;
+  enteredAt = millis();
+  if (next == MOTION_IDLE && callback)
+    callback(last == MOTION_FAULT ? MOTION_FAILED : missed ? MOTION_MISSED : MOTION_REACHED);
+}
+
+//Signed duty, positive = up
+void Motion::drive(int pwm) {
+  if (pwm > 0)
+    goUp(min(pwm, PWM_SPEED_UP));
+  else if (pwm < 0)
+    goDown(min(-pwm, PWM_SPEED_DOWN));
+  else
+    stopMoving();
+}
+
+int Motion::fullDuty() {
+  return dir > 0 ? PWM_SPEED_UP : PWM_SPEED_DOWN;
+}
+
+int Motion::remaining(int height) {
+  return (targetHeight - height) * dir;
+}
+
+int Motion::error(int height) {
+  return targetHeight - height;
+}
+
+//Hands over to the height controller, its first update follows right away
+MotionState Motion::startControl() {
+  pid.reset();
+  stopSpeed = 0;
+  controlledAt = millis() - CONTROL_INTERVAL;
+  return MOTION_APPROACH;
+}
+
+MotionState Motion::idle(int height) {
+  return MOTION_IDLE;
+}
+
+//The motor profile ramps the duty up, this state only waits until it is there
+MotionState Motion::rampUp(int height) {
+  drive(fullDuty() * dir);
+  if (remaining(height) <= APPROACH_DISTANCE)
+    return startControl();
+  if (abs(motorDuty()) >= fullDuty())
+    return MOTION_CRUISE;
+  return MOTION_RAMP_UP;
+}
+
+MotionState Motion::cruise(int height) {
+  drive(fullDuty() * dir);
+  if (remaining(height) <= APPROACH_DISTANCE)
+    return startControl();
+  return MOTION_CRUISE;
+}
+
+//Closed loop: the PID controller turns the height error into a signed duty until the desk is within the deadband
+MotionState Motion::approach(int height) {
+  if (inState() >= APPROACH_TIMEOUT) {
+    stopMoving();
+    corrections = MAX_CORRECTIONS;
+    return MOTION_SETTLE;
+  }
+  unsigned long now = millis();
+  if (now - controlledAt < (unsigned long)CONTROL_INTERVAL)
+    return MOTION_APPROACH;
+  unsigned int dt = now - controlledAt;
+  controlledAt = now;
+
+  //Stop ahead: where the desk comes to rest if the motors are stopped now. While it still closes in on
+  //the target it keeps going, so it stops at the target rather than at the edge of the deadband
+  int stopsAt = height + (long)speed * coastTime(speed > 0 ? 1 : -1) / 1000;
+  bool closingIn = (long)error(stopsAt) * speed > 0;
+  if (abs(error(stopsAt)) <= DEADBAND && !closingIn) {
+    stopMoving();
+    stopHeight = height;
+    stopSpeed = speed;
+    return MOTION_SETTLE;
+  }
+  int output = pid.update(error(height), speed, dt);
+  if (output > 0)
+    drive(output + BREAKAWAY_PWM_UP);
+  else if (output < 0)
+    drive(output - BREAKAWAY_PWM_DOWN);
+  else
+    stopMoving();
+  return MOTION_APPROACH;
+}
+
+//Waits for the desk to come to rest, then checks whether it really is within the deadband
+MotionState Motion::settle(int height) {
+  if (motorDuty() != 0 || inState() < (unsigned long)SETTLE_TIME)
+    return MOTION_SETTLE;
+  if (height == 0) //Sonar error: where the desk came to rest is unknown, nothing to learn or correct by
+    return MOTION_FAULT;
+  learnCoast(height);
+  if (abs(error(height)) > DEADBAND) {
+    if (corrections < MAX_CORRECTIONS) {
+      corrections++;
+      return startControl();
+    }
+    missed = true;
+  }
+  return MOTION_IDLE;
+}
+
+//Compares where the desk came to rest with where the motors were stopped
+void Motion::learnCoast(int height) {
+  if (abs(stopSpeed) < COAST_MIN_SPEED)
+    return;
+  int8_t direction = stopSpeed > 0 ? 1 : -1;
+  long measured = constrain((long)(height - stopHeight) * 1000 / stopSpeed, 0L, (long)COAST_MAX);
+  int time = coastTime(direction);
+  setCoastTime(direction, time + (measured - time) / COAST_LEARN_RATE);
+  stopSpeed = 0;
+}
+
+MotionState Motion::fault(int height) {
+  haltMotors();
+  return MOTION_IDLE;
+}
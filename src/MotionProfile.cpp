@@ -0,0 +1,67 @@
+/*
+  MotionProfile.cpp
+
+  See MotionProfile.h
+*/
+#include "MotionProfile.h"
+
+static unsigned long isqrt(unsigned long n) {
+  unsigned long root = 0;
+  unsigned long bit = 1UL << 30;
+  while (bit > n)
+    bit >>= 2;
+  while (bit != 0) {
+    if (n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+    bit >>= 2;
+  }
+  return root;
+}
+
+void MotionProfile::halt() {
+  goal = 0;
+  out = 0;
+  position = 0;
+  rate = 0;
+}
+
+int MotionProfile::update(unsigned int dtMs) {
+  long error = (long)goal * 1000 - position;
+  if (error == 0 && rate == 0)
+    return out;
+
+  //Fastest rate from which the jerk limit can still brake to 0 exactly at the goal: r = sqrt(2 * jerk * error)
+  //2 * jerk * distance / 1000 in 32 bits, whole duty steps and the rest apart: exact as long as the result
+  //fits (a jerk of 32000 across the full -1023..1023 range is 131 M) and no 64 bit division every tick
+  unsigned long distance = error < 0 ? -error : error;
+  unsigned long twoJerk = 2UL * jerk;
+  long brakeRate = isqrt(twoJerk * (distance / 1000) + twoJerk * (distance % 1000) / 1000);
+  long wanted = min((long)accel, brakeRate);
+  if (error < 0)
+    wanted = -wanted;
+
+  long maxChange = (long)jerk * dtMs / 1000;
+  if (maxChange < 1)
+    maxChange = 1;
+  rate += constrain(wanted - rate, -maxChange, maxChange);
+  position += rate * (long)dtMs; //duty/s * ms = 1/1000 duty
+
+  long remaining = (long)goal * 1000 - position;
+  if (remaining == 0 || (remaining < 0) != (error < 0)) { //arrived or passed the goal
+    position = (long)goal * 1000;
+    rate = 0;
+  }
+
+  int next = (position + (position < 0 ? -500 : 500)) / 1000;
+  if ((out > 0 && next < 0) || (out < 0 && next > 0)) { //pause at 0 before changing direction
+    next = 0;
+    position = 0;
+    rate = 0;
+  }
+  out = next;
+  return out;
+}
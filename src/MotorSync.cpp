@@ -0,0 +1,42 @@
+/*
+  MotorSync.cpp
+
+  See MotorSync.h
+*/
+#include "MotorSync.h"
+
+void MotorSync::reset() {
+  trimValue = 0;
+  primed = false;
+}
+
+void MotorSync::update(int currentA, int currentB) {
+  if (!primed) {
+    filteredA = (long)currentA << SYNC_FILTER;
+    filteredB = (long)currentB << SYNC_FILTER;
+    primed = true;
+  }
+  //Exponential moving average, the PWM makes single samples jumpy
+  filteredA += currentA - (filteredA >> SYNC_FILTER);
+  filteredB += currentB - (filteredB >> SYNC_FILTER);
+
+  //A works harder: more duty for B
+  long difference = (filteredA - filteredB) >> SYNC_FILTER;
+  trimValue = constrain(trimValue + difference * SYNC_GAIN, -SYNC_MAX_TRIM * 64L, SYNC_MAX_TRIM * 64L);
+}
+
+void MotorSync::split(int duty, int &dutyA, int &dutyB) {
+  int magnitude = abs(duty);
+  int a = magnitude;
+  int b = magnitude + trim();
+  if (b > MOTOR_DUTY_MAX) { //no headroom left for B, slow A down instead
+    a -= b - MOTOR_DUTY_MAX;
+    b = MOTOR_DUTY_MAX;
+  }
+  if (magnitude == 0 || b < 0)
+    b = 0;
+  if (a < 0)
+    a = 0;
+  dutyA = duty < 0 ? -a : a;
+  dutyB = duty < 0 ? -b : b;
+}
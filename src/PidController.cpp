@@ -0,0 +1,31 @@
+/*
+  PidController.cpp
+
+  See PidController.h
+*/
+#include "PidController.h"
+
+PidController::PidController(int kp, int ki, int kd, int limit) : kp(kp), ki(ki), kd(kd), limit(limit) {
+  //largest integral whose contribution still fits into the output range
+  integralMax = ki > 0 ? (long)limit * PID_SCALE * 1000 / ki : 0;
+}
+
+void PidController::reset() {
+  integral = 0;
+}
+
+int PidController::update(long error, long rate, unsigned int dtMs) {
+  long p = kp * error;
+  long d = -(long)kd * rate;
+  long i = ki * (integral / 1000);
+  long output = (p + i + d) / PID_SCALE;
+
+  //Only integrate while that can still change the output (conditional integration)
+  bool saturated = (output >= limit && error > 0) || (output <= -limit && error < 0);
+  if (!saturated) {
+    integral = constrain(integral + error * (long)dtMs, -integralMax, integralMax);
+    i = ki * (integral / 1000);
+    output = (p + i + d) / PID_SCALE;
+  }
+  return constrain(output, (long)-limit, (long)limit);
+}
@@ -0,0 +1,70 @@
+/*
+  Profiler.cpp
+
+  See Profiler.h
+*/
+#include "Profiler.h"
+
+#ifdef PROFILING
+
+static const char* const stageNames[PROFILE_STAGE_COUNT] = {
+  "loop", "buttons", "handlers", "sonar", "motion", "tasks", "display"
+};
+
+static ProfileStats stats[PROFILE_STAGE_COUNT];
+
+void profileBegin(ProfileStage stage) {
+  stats[stage].startedAt = micros();
+}
+
+void profileEnd(ProfileStage stage) {
+  ProfileStats &s = stats[stage];
+  unsigned long elapsed = micros() - s.startedAt;
+
+  if (s.count == 0 || elapsed < s.min)
+    s.min = elapsed;
+  if (elapsed > s.max)
+    s.max = elapsed;
+  s.total += elapsed;
+  s.count++;
+
+  //bucket 0 is everything below 16 us, every further bucket doubles
+  uint8_t bucket = 0;
+  for (unsigned long limit = 16; elapsed >= limit && bucket < PROFILE_BUCKETS - 1; limit <<= 1)
+    bucket++;
+  if (s.histogram[bucket] < 0xFFFF)
+    s.histogram[bucket]++;
+}
+
+void profileReset() {
+  memset(stats, 0, sizeof(stats));
+}
+
+void profilePrint() {
+  Serial.println("stage\tcount\tmin\tmean\tmax\t<16\t<32\t<64\t<128\t<256\t<512\t<1k\t>=1k");
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) {
+    ProfileStats &s = stats[i];
+    Serial.print(stageNames[i]); Serial.print('\t');
+    Serial.print(s.count); Serial.print('\t');
+    Serial.print(s.min); Serial.print('\t');
+    Serial.print(s.count > 0 ? s.total / s.count : 0); Serial.print('\t');
+    Serial.print(s.max);
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+      Serial.print('\t'); Serial.print(s.histogram[b]);
+    }
+    Serial.println();
+  }
+}
+
+//Printing takes a while, so only call this outside of the measured stages
+void profilePoll() {
+  while (Serial.available() > 0) {
+    int command = Serial.read();
+    if (command == 'p')
+      profilePrint();
+    else if (command == 'r')
+      profileReset();
+  }
+}
+
+#endif // PROFILING
@@ -0,0 +1,21 @@
+/*
+  QuadratureEncoder.cpp
+
+  See QuadratureEncoder.h
+*/
+#include "QuadratureEncoder.h"
+
+//Step for every (previous state << 2 | new state), states are (A << 1 | B): 00 -> 01 -> 11 -> 10 counts up
+const int8_t QuadratureDecoder::STEPS[16] = {
+   0, +1, -1,  0,
+  -1,  0,  0, +1,
+  +1,  0,  0, -1,
+   0, -1, +1,  0
+};
+
+long QuadratureDecoder::count() {
+  noInterrupts();
+  long counts = position;
+  interrupts();
+  return counts;
+}
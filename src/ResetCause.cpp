@@ -0,0 +1,32 @@
+/*
+  ResetCause.cpp
+
+  See ResetCause.h
+*/
+#include "ResetCause.h"
+
+#define RESET_FLAGS (RESET_POWER_ON | RESET_EXTERNAL | RESET_BROWN_OUT | RESET_WATCHDOG)
+
+#if defined(__AVR__)
+
+//r2 as the bootloader left it. .init0 runs before anything else, r2 is still untouched there
+static uint8_t bootloaderFlags __attribute__((section(".noinit")));
+
+void saveBootloaderFlags() __attribute__((naked, used, section(".init0")));
+void saveBootloaderFlags() {
+  __asm__ __volatile__("sts %0, r2\n" : "=m"(bootloaderFlags) :);
+}
+
+#else
+
+static uint8_t bootloaderFlags = 0;
+
+#endif
+
+uint8_t readResetCause() {
+  uint8_t flags = MCUSR & RESET_FLAGS;
+  MCUSR = 0;
+  if (flags == 0) //cleared by the bootloader, optiboot passed the flags on in r2
+    flags = bootloaderFlags & RESET_FLAGS;
+  return flags;
+}
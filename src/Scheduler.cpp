@@ -0,0 +1,54 @@
+/*
+  Scheduler.cpp
+
+  See Scheduler.h
+*/
+#include "Scheduler.h"
+
+uint8_t Scheduler::add(TaskCallback callback, unsigned long interval) {
+  if (count >= SCHEDULER_MAX_TASKS)
+    return TASK_NONE;
+
+  Task &task = tasks[count];
+  task.callback = callback;
+  task.interval = interval;
+  task.due = millis();
+  task.active = interval > 0;
+  return count++;
+}
+
+void Scheduler::runIn(uint8_t task, unsigned long delayMs) {
+  if (task >= count)
+    return;
+  tasks[task].due = millis() + delayMs;
+  tasks[task].active = true;
+}
+
+void Scheduler::cancel(uint8_t task) {
+  if (task < count)
+    tasks[task].active = false;
+}
+
+bool Scheduler::pending(uint8_t task) {
+  return task < count && tasks[task].active;
+}
+
+void Scheduler::run() {
+  for (uint8_t i = 0; i < count; i++) {
+    Task &task = tasks[i];
+    unsigned long now = millis();
+    if (!task.active || (long)(now - task.due) < 0)
+      continue;
+
+    //Re-arm before the callback runs, so a task can reschedule or cancel itself
+    if (task.interval > 0) {
+      task.due += task.interval;
+      if ((long)(now - task.due) >= 0) //fell behind, don't try to catch up with a burst of calls
+        task.due = now + task.interval;
+    }
+    else {
+      task.active = false;
+    }
+    task.callback();
+  }
+}
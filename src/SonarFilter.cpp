@@ -0,0 +1,88 @@
+/*
+  SonarFilter.cpp
+
+  See SonarFilter.h
+*/
+#include "SonarFilter.h"
+
+SonarFilter::SonarFilter(unsigned int minValue, unsigned int maxValue, unsigned int maxSpeed, unsigned int margin)
+  : minValue(minValue), maxValue(maxValue), maxSpeed(maxSpeed), margin(margin) {
+}
+
+//Within the range and not further from the accepted readings than the desk can move
+bool SonarFilter::plausible(unsigned int reading, unsigned long now) {
+  if (reading < minValue || reading > maxValue)
+    return false;
+  if (count == 0 && goodRun == 0)
+    return true; //nothing to compare with yet
+
+  unsigned long maxJump = margin + (unsigned long)maxSpeed * (now - acceptedAt) / 1000;
+  unsigned int last = reference();
+  unsigned int jump = reading > last ? reading - last : last - reading;
+  return jump <= maxJump;
+}
+
+bool SonarFilter::add(unsigned int reading, unsigned long now) {
+  if (!plausible(reading, now)) {
+    goodRun = 0;
+    if (badRun < SONAR_ERROR_ENTER)
+      badRun++;
+    if (badRun >= SONAR_ERROR_ENTER && !failedState) {
+      failedState = true;
+      //Start over once the sensor is back, the old readings say nothing about the desk anymore
+      count = 0;
+      head = 0;
+    }
+    return false;
+  }
+  badRun = 0;
+
+  if (failedState) {
+    //Recovering: the readings have to agree with each other for a while before they count
+    lastAccepted = reading;
+    acceptedAt = now;
+    if (++goodRun < SONAR_ERROR_LEAVE)
+      return false;
+    failedState = false;
+    goodRun = 0;
+  }
+
+  samples[head] = reading;
+  head = (head + 1) % SONAR_FILTER_SIZE;
+  if (count < SONAR_FILTER_SIZE)
+    count++;
+  lastAccepted = reading;
+  acceptedAt = now;
+  return true;
+}
+
+unsigned int SonarFilter::reach(unsigned long now) {
+  if (failedState || count == 0)
+    return maxValue;
+  unsigned long farthest = reference() + margin + (unsigned long)maxSpeed * (now - acceptedAt) / 1000;
+  return min(farthest, (unsigned long)maxValue);
+}
+
+unsigned int SonarFilter::value() {
+  if (failedState || count == 0)
+    return 0;
+  return median();
+}
+
+//What the jump check compares with: the median, or while recovering the last candidate
+unsigned int SonarFilter::reference() {
+  return count > 0 ? median() : lastAccepted;
+}
+
+unsigned int SonarFilter::median() {
+  //Insertion sort of a copy, the buffer is tiny
+  unsigned int sorted[SONAR_FILTER_SIZE];
+  for (uint8_t i = 0; i < count; i++) {
+    unsigned int sample = samples[i];
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > sample; j--)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = sample;
+  }
+  return sorted[count / 2];
+}
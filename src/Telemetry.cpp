@@ -0,0 +1,59 @@
+/*
+  Telemetry.cpp
+
+  See Telemetry.h
+*/
+#include "Telemetry.h"
+
+#ifdef PROFILING
+
+void Telemetry::send(TelemetryEvent event, unsigned long time, int height, int pwm, uint8_t state, uint8_t flags, int value) {
+}
+
+void Telemetry::drain() {
+}
+
+#else
+
+#define TELEMETRY_MASK (TELEMETRY_BUFFER - 1)
+
+void Telemetry::put(uint8_t b) {
+  buffer[head & TELEMETRY_MASK] = b;
+  head++;
+  checksum += b;
+}
+
+void Telemetry::send(TelemetryEvent event, unsigned long time, int height, int pwm, uint8_t state, uint8_t flags, int value) {
+  uint8_t used = head - tail;
+  if (TELEMETRY_BUFFER - used < TELEMETRY_FRAME_SIZE) {
+    droppedFrames++;
+    lostFrame = true;
+    return;
+  }
+  if (lostFrame) {
+    flags |= TELEMETRY_FLAG_DROPPED;
+    lostFrame = false;
+  }
+
+  put(TELEMETRY_SYNC_1);
+  put(TELEMETRY_SYNC_2);
+  checksum = 0;
+  put(event);
+  put(time); put(time >> 8); put(time >> 16); put(time >> 24);
+  put(height); put(height >> 8);
+  put(pwm); put(pwm >> 8);
+  put(state);
+  put(flags);
+  put(value); put(value >> 8);
+  put(checksum);
+}
+
+void Telemetry::drain() {
+  int room = Serial.availableForWrite();
+  while (room-- > 0 && tail != head) {
+    Serial.write(buffer[tail & TELEMETRY_MASK]);
+    tail++;
+  }
+}
+
+#endif // PROFILING
@@ -0,0 +1,72 @@
+/*
+  Thermometer.cpp
+
+  See Thermometer.h
+*/
+#include "Thermometer.h"
+
+#if defined(TEMPERATURE_PIN)
+
+bool Thermometer::available() {
+  return true;
+}
+
+void Thermometer::select() {
+}
+
+void Thermometer::deselect() {
+}
+
+//TMP36: 500 mV at 0 degrees, 10 mV per degree, read against the 5 V supply
+int Thermometer::read() {
+  long millivolts = analogRead(TEMPERATURE_PIN) * 5000L / 1023;
+  return millivolts - 500;
+}
+
+#elif defined(__AVR_ATmega328P__)
+
+bool Thermometer::available() {
+  return true;
+}
+
+void Thermometer::select() {
+  ADMUX = _BV(REFS1) | _BV(REFS0) | _BV(MUX3); //internal 1.1 V reference, channel 8
+}
+
+static void convert() {
+  ADCSRA |= _BV(ADSC);
+  while (bit_is_set(ADCSRA, ADSC));
+}
+
+//Typical curve of the datasheet: 324.31 counts at 0 degrees, 1.22 counts per degree
+int Thermometer::read() {
+  convert();
+  long counts = ADC;
+  deselect();
+  return (counts * 1000 - 324310) / 122 + THERMOMETER_OFFSET;
+}
+
+//Back to the AVcc reference of analogRead(). The first conversion after switching the reference is off
+//(see the datasheet), throw it away here rather than in the next analogRead()
+void Thermometer::deselect() {
+  ADMUX = _BV(REFS0);
+  convert();
+}
+
+#else
+
+bool Thermometer::available() {
+  return false;
+}
+
+void Thermometer::select() {
+}
+
+void Thermometer::deselect() {
+}
+
+int Thermometer::read() {
+  return 0;
+}
+
+#endif
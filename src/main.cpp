@@ -11,15 +11,16 @@
     On my particular setup (a heavy water cooled tower-PC and one 49" monitor totaling around 35-40 kg) I use 100% of the power speed and torque when raising the desk,
     however, when lowering the desk I need a bit less since gravity helps, to keep the speed up and down at a similar rate, this is configurable.
     You may want to tweak the variables PWM_SPEED_UP and PWM_SPEED_DOWN to adjust it to your desktop load, the allowed values
-    are 0 (min) to 255 (max).
+    are 0 (min) to 1023 (max).
 
   BASIC USAGE
     - Press and hold BUTTON_UP to raise the desk. a small delay of 250ms has been introduced for smoothness
     - Press and hold BUTTON_DOWN to lower the desk. a small delay of 250ms has been introduced for smoothness
     - Press and hold the "Position 0" button to save the lower/sitting position
     - Press and hold the "Position 1" button to save the higher/standing position
-    - Press the "Position 0" button shortly to automatically have the desk drive into this position. It stops as soon as the sonar sensor reads the distance from the ground is equal or lower than saved
-    - Press the "Position 1" button shortly to automatically have the desk drive into this position. It stops as soon as the sonar sensor reads the distance from the ground is equal or higher than saved
+    - Press the "Position 0" button shortly to automatically have the desk drive into this position (up or down, whichever is needed). It stops as soon as the sonar sensor reads the saved height
+    - Press the "Position 1" button shortly to automatically have the desk drive into this position (up or down, whichever is needed). It stops as soon as the sonar sensor reads the saved height
+    - Pressing UP or DOWN while the desk drives into a position cancels the program
     - The desk should also automatically stop as soon as there is an error in the sonar reading
 
   ERROR CODES
@@ -43,179 +44,409 @@
 #include <Arduino.h>
 #include <TM1637Display.h>
 #include <Ultrasonic.h>
+#include <FastPin.h>
+#include <L298NDriver.h>
+#include "Pins.h"
+#include "StoredProgram.h"
+#include "Scheduler.h"
+#include "Motor.h"
+#include "Motion.h"
+#include "MotionProfile.h"
+#include "Profiler.h"
+#include "Telemetry.h"
+#include "SonarFilter.h"
+#include "HeightKalman.h"
+#include "Thermometer.h"
+#include "Animation.h"
+#include "ResetCause.h"
+#ifdef USE_ENCODERS
+#include "QuadratureEncoder.h"
+#include "HeightFusion.h"
+#endif
+#ifdef USE_CURRENT_SENSE
+#include "MotorSync.h"
+#endif
 
 /* TO DO
 - 
 */
 
-#define BUTTON_UP 2     
-#define BUTTON_DOWN 3   
-#define BUTTON_POS_0 4  
-#define BUTTON_POS_1 5  
-#define enA 6           
-#define in1 7           
-#define in2 8           
-#define enB 10          
-#define in3 11          
-#define in4 12          
-#define CLK 14          // 7 Segment
-#define DIO 15          // 7 Segment
-#define ECHO_PIN 16     // Arduino pin tied to echo pin on the ultrasonic sensor
-#define TRIGGER_PIN 17  // Arduino pin tied to trigger pin on the ultrasonic sensor
-
-Ultrasonic ultrasonic(TRIGGER_PIN, ECHO_PIN);
-TM1637Display display(CLK, DIO);
+FastUltrasonic<TRIGGER_PIN, ECHO_PIN> ultrasonic;
+FastTM1637Display<CLK, DIO> display;
+//Up turns motor A with in1 LOW / in2 HIGH and the mirrored motor B with in3 LOW / in4 HIGH
+L298NDriver<enA, in1, in2, enB, in3, in4, Timer1Pwm> motors(true, true);
+Scheduler scheduler;
+Motion motion;
+Telemetry telemetry;
+#ifdef USE_ENCODERS
+//Both motors turn the same shaft, motor B the other way round. Counts per cm: 64 per motor revolution
+//times the 50:1 gearbox, at roughly 6 mm of desk travel per turn (check with a long drive against the sonar)
+const long ENCODER_COUNTS_PER_CM = 5333;
+QuadratureEncoder<ENCODER_A1, ENCODER_A2> encoderA;
+QuadratureEncoder<ENCODER_B1, ENCODER_B2> encoderB;
+HeightFusion heightFusion(ENCODER_COUNTS_PER_CM);
+void encoderAChanged() { encoderA.changed(); }
+void encoderBChanged() { encoderB.changed(); }
+long encoderCounts();
+#endif
+//Height and velocity for the auto-drive programs (see HeightKalman.h). Without the encoders it is
+//corrected by every sonar reading, with them by the fused height at every tick
+#ifdef USE_ENCODERS
+HeightKalman heightEstimator(500);  //um, noise of the fused height
+#else
+HeightKalman heightEstimator(2500); //um, sonar noise
+#endif
+const int ESTIMATOR_INTERVAL = 20;  //ms, the control tick
+void estimatorTask();
+Thermometer thermometer;
+const unsigned long TEMPERATURE_INTERVAL = 10000; //ms between two temperature measurements for the sonar
+uint8_t temperatureTaskId;
+void temperatureTask();
+#ifdef USE_CURRENT_SENSE
+MotorSync motorSync;
+const int SYNC_INTERVAL = 20; //ms between two load balancing steps of the motors
+void syncTask();
+#endif
 
 // Definitions for Platformio
 void readFromEEPROM();
+void saveCoast();
 void handleButtonUp();
 void handleButtonDown();
 void position_0();
 void position_1();
 void checkHeight();
-void goDown();
-void goUp();
-void stopMoving();
+void applyDuty(int duty);
+void motorTask();
+int motionHeight();
+int motionVelocity();
 
-//Struct to store the various necessary variables to persist the autoRaise/autoLower programs to EEPROM
-struct StoredProgram
+//Debounced state of a button, updated once per loop() without blocking
+struct Button
 {
-  int pos0Height = 0; //height in cm above ground for the sitting position
-  int pos1Height = 0; //height in cm above ground for the standing position
+  bool (*read)();           //reads the pin, see FastPin.h
+  bool state;               //debounced state
+  bool reading;             //last raw reading
+  unsigned long changedAt;  //time the raw reading last changed
+  bool pressed;             //true only in the loop() the button went down
+  bool released;            //true only in the loop() the button went up
 };
 
+void debounceRead(Button &button);
+void handleCancel();
+void handlePositionButton(Button &button, int position);
+void savePosition(int position);
+void startProgram(int position);
+void programFinished(MotionResult result);
+void sonarTask();
+void readSonar();
+void animationTask();
+void report(TelemetryEvent event, int value = 0);
+
 StoredProgram savedProgram;
 int EEPROM_ADDRESS = 0;
-int BUTTON_UP_STATE = LOW;
-int BUTTON_DOWN_STATE = LOW;
-int BUTTON_POS_0_STATE = LOW;
-int BUTTON_POS_1_STATE = LOW;
+StoredCoast savedCoast;
+int COAST_EEPROM_ADDRESS = EEPROM_ADDRESS + sizeof(StoredProgram);
+const int COAST_SAVE_CHANGE = 5; //ms a learned coast time has to differ from the saved one to be written
+Button buttonUp = {FastPin<BUTTON_UP>::read};
+Button buttonDown = {FastPin<BUTTON_DOWN>::read};
+Button buttonPos0 = {FastPin<BUTTON_POS_0>::read};
+Button buttonPos1 = {FastPin<BUTTON_POS_1>::read};
 long BUTTON_WAIT_TIME = 250; //the small delay before starting to go up/down for smoothness on any button
+const int DEBOUNCE_TIME = 10; //a button reading has to be stable this long (ms) before it counts
 
 //Using custom values to ensure no more than 24v are delivered to the motors given my desk load.
 //feel free to play with these numbers but make sure to stay within your motor's rated voltage.
-const int PWM_SPEED_UP = 255; //0 - 255, controls motor speed when going UP
-const int PWM_SPEED_DOWN = 220; //0 - 255, controls motor speed when going DOWN
+const int PWM_SPEED_UP = 1023; //0 - 1023, controls motor speed when going UP
+const int PWM_SPEED_DOWN = 883; //0 - 1023, controls motor speed when going DOWN
+
+//How gently the duty is ramped, also when stopping. Higher values react faster but jolt more
+const unsigned int MOTOR_ACCEL = 4000; //max change of the duty per second
+const unsigned int MOTOR_JERK = 32000; //max change of MOTOR_ACCEL per second
+const int MOTOR_TICK = 5;              //ms between two duty updates
 
 // Required for additional buttons
 long pressedTime;
 long releasedTime;
 long TimePressed;
 const int LONG_PRESS_TIME  = 2000; // The time button "0" or "1" need to be pressed to register as a "long" press to save the current position to eeprom.
+int heldPosition = -1; //the position button (0 or 1) currently held down, -1 if none
 
 // Required for the ultrasonic sensor
 int old_Height;
-int current_height = 0;
+int current_height = 0; //mm, like all heights below
 int pos0_height = 0;
 int pos1_height = 0;
-int digitPosition = 0;
+const int DISPLAY_STEP = 2; //mm the height has to change before the display follows, the last digit would flicker otherwise
+const uint8_t HEIGHT_DOTS = 0b00100000; //heights are shown in cm with one decimal: 000.0
+bool trackHeight = false; //while true every sonar reading is shown on the display
+const int SONAR_INTERVAL = 50; //polling frequency of the sonar sensor. Not recommended to go below 30-50 ms
+const int SONAR_MIN_HEIGHT = 400;  //readings outside can't be the desk
+const int SONAR_MAX_HEIGHT = 1600;
+const int SONAR_MAX_SPEED = 60;    //mm/s, a bit faster than the desk ever moves
+const int SONAR_NOISE_MARGIN = 20; //jitter of the readings on top of the travel
+SonarFilter sonarFilter(SONAR_MIN_HEIGHT, SONAR_MAX_HEIGHT, SONAR_MAX_SPEED, SONAR_NOISE_MARGIN);
+
+// Motor and program state
+int motorDirection = 0;   //1 = up, -1 = down, 0 = stopped
+int motorPwm = 0;         //duty requested for both enable pins, the applied one ramps towards it
+MotionProfile motorProfile(MOTOR_ACCEL, MOTOR_JERK);
+int manualDirection = 0;  //direction requested by holding BUTTON_UP (1) or BUTTON_DOWN (-1)
+
+// Display sequences
+uint8_t animationTaskId;
+int sequencePosition = 0; //the position (0 or 1) shown by the position sequences
+int sequenceHeight = 0;   //the height shown by the save sequence
+const int QUICK_BOOT_WAIT = 300; //ms until the sonar filter has a height after a reset
+
+// Texts for the display, encoded at compile time
+constexpr TM1637Text POSITION0_TEXT = tm1637Text("P 0 ");
+constexpr TM1637Text POSITION1_TEXT = tm1637Text("P 1 ");
+constexpr TM1637Text SAVE_ERROR0_TEXT = tm1637Text("Err0");
+constexpr TM1637Text SAVE_ERROR1_TEXT = tm1637Text("Err1");
+constexpr TM1637Text HEIGHT_ERROR_TEXT = tm1637Text("Err2");
+constexpr TM1637Text MISSED_TEXT = tm1637Text("Err3");
+
+//This function debounces the button reads to prevent flickering. A change only counts once the reading has been stable for DEBOUNCE_TIME
+void debounceRead(Button &button)
+{
+  bool reading = button.read();
+  unsigned long now = millis();
+  button.pressed = false;
+  button.released = false;
+  if (reading != button.reading)
+  {
+    button.reading = reading;
+    button.changedAt = now;
+  }
+  else if (reading != button.state && now - button.changedAt >= DEBOUNCE_TIME)
+  {
+    button.state = reading;
+    button.pressed = reading;
+    button.released = !reading;
+  }
+}
+
+//Height in mm, shown in cm with one decimal
+void showHeight(int height){
+  display.showNumberDecEx(height, HEIGHT_DOTS, false);
+}
+
+void clearDisplay(){
+  display.clear();
+  old_Height = 0; //make sure the next height is drawn again
+}
+
+void showPosition(){
+  display.showText(sequencePosition == 0 ? POSITION0_TEXT : POSITION1_TEXT);
+}
+
+void showSaveError(){
+  display.showText(sequencePosition == 0 ? SAVE_ERROR0_TEXT : SAVE_ERROR1_TEXT);
+}
+
+/****************************************
+  DISPLAY ANIMATIONS
+  Keyframe tables in PROGMEM, played by the animator (see Animation.h). animationTask() draws one keyframe
+  and comes back when its hold time is over, so buttons, sonar and motors keep being serviced in between.
+  Content only known at run time is drawn by the actions below.
+****************************************/
+enum AnimationAction : uint8_t {
+  SHOW_NOTHING,
+  SHOW_CLEAR,
+  SHOW_POSITION,        //"P 0" / "P 1" of sequencePosition
+  SHOW_SAVE_ERROR,      //"Err0" / "Err1" of sequencePosition
+  SHOW_POS0_HEIGHT,
+  SHOW_POS1_HEIGHT,
+  SHOW_SAVED_HEIGHT,    //sequenceHeight
+  SHOW_CURRENT_HEIGHT   //the height, or "Err2"
+};
+
+//Higher ones can't be interrupted by lower ones
+enum AnimationPriority : uint8_t {
+  PRIORITY_BOOT,
+  PRIORITY_INFO,
+  PRIORITY_FEEDBACK,
+  PRIORITY_ERROR
+};
 
-// Some digits/figures for the display
-const uint8_t P[] = {
-  SEG_A | SEG_B | SEG_E | SEG_F | SEG_G, // P
+void renderAnimation(uint8_t action){
+  switch (action){
+    case SHOW_CLEAR: clearDisplay(); break;
+    case SHOW_POSITION: showPosition(); break;
+    case SHOW_SAVE_ERROR: showSaveError(); break;
+    case SHOW_POS0_HEIGHT: showHeight(pos0_height); break;
+    case SHOW_POS1_HEIGHT: showHeight(pos1_height); break;
+    case SHOW_SAVED_HEIGHT: showHeight(sequenceHeight); break;
+    case SHOW_CURRENT_HEIGHT:
+      old_Height = 0; //draw it even if it didn't change, the frame before drew something else
+      checkHeight();
+      break;
+  }
+}
+
+Animator animator(display, renderAnimation);
+
+#define DIGIT(n, c) {{(n) == 0 ? tm1637Glyph(c) : 0, (n) == 1 ? tm1637Glyph(c) : 0, (n) == 2 ? tm1637Glyph(c) : 0, (n) == 3 ? tm1637Glyph(c) : 0}}, 1 << (n), SHOW_NOTHING
+#define SHOW(action) {{0, 0, 0, 0}}, 0, (action)
+
+//Start-up animation, then the saved positions and the current height
+const Keyframe bootFrames[] PROGMEM = {
+  {DIGIT(0, 'o'), 100}, {DIGIT(1, 'o'), 100}, {DIGIT(2, 'o'), 100}, {DIGIT(3, 'o'), 100},
+  {DIGIT(0, '*'), 100}, {DIGIT(1, '*'), 100}, {DIGIT(2, '*'), 100}, {DIGIT(3, '*'), 100},
+  {DIGIT(0, '0'), 100}, {DIGIT(1, '0'), 100}, {DIGIT(2, '0'), 100}, {DIGIT(3, '0'), 100},
+  {DIGIT(0, ' '), 100}, {DIGIT(1, ' '), 100}, {DIGIT(2, ' '), 100}, {DIGIT(3, ' '), 100},
+  {SHOW(SHOW_CLEAR), 400},
+  {POSITION0_TEXT, ANIMATION_DIGITS, SHOW_NOTHING, 1000}, // Display the saved Position 0 height
+  {SHOW(SHOW_POS0_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 400},
+  {POSITION1_TEXT, ANIMATION_DIGITS, SHOW_NOTHING, 1000},  // Display the saved Position 1 height
+  {SHOW(SHOW_POS1_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 400},
+  {SHOW(SHOW_CURRENT_HEIGHT), 1500}, // Display the current height
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t Zero[] = {
-  SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F, // 0
+const Animation bootAnimation PROGMEM = {bootFrames, PRIORITY_BOOT};
+
+//Start-up after a brown-out or watchdog reset, the desk was just in use: only the height, once the sonar has it
+const Keyframe quickBootFrames[] PROGMEM = {
+  {SHOW(SHOW_NOTHING), QUICK_BOOT_WAIT},
+  {SHOW(SHOW_CURRENT_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t One[] = {
-  SEG_B | SEG_C, // 1
+const Animation quickBootAnimation PROGMEM = {quickBootFrames, PRIORITY_BOOT};
+
+//Small animation while a position button is held down, "0000" tells the button can be released to save
+const Keyframe longPressFrames[] PROGMEM = {
+  {SHOW(SHOW_NOTHING), 400},
+  {DIGIT(0, 'o'), 400}, {DIGIT(1, 'o'), 400}, {DIGIT(2, 'o'), 400}, {DIGIT(3, 'o'), 400},
+  {tm1637Text("0000"), ANIMATION_DIGITS, SHOW_NOTHING, 0}
 };
-const uint8_t Two[] = {
-  SEG_A | SEG_B | SEG_G | SEG_E | SEG_D, // 2
+const Animation longPressAnimation PROGMEM = {longPressFrames, PRIORITY_FEEDBACK};
+
+//"P 0" / "P 1" followed by the height that was just saved
+const Keyframe savedFrames[] PROGMEM = {
+  {SHOW(SHOW_POSITION), 1000},
+  {SHOW(SHOW_SAVED_HEIGHT), 1000},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t E[] = {
-  SEG_A | SEG_D | SEG_E | SEG_F | SEG_G, // E
+const Animation savedAnimation PROGMEM = {savedFrames, PRIORITY_FEEDBACK};
+
+//"Err0" / "Err1"
+const Keyframe saveErrorFrames[] PROGMEM = {
+  {SHOW(SHOW_SAVE_ERROR), 1000},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t R[] = {
-  SEG_E | SEG_G, // r
-  SEG_E | SEG_G, // r
+const Animation saveErrorAnimation PROGMEM = {saveErrorFrames, PRIORITY_ERROR};
+
+//"P 0" / "P 1" once the program reached its position, followed by the height
+const Keyframe reachedFrames[] PROGMEM = {
+  {SHOW(SHOW_POSITION), 1000},
+  {SHOW(SHOW_CURRENT_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t Minus[] = {
-  SEG_G  // -
+const Animation reachedAnimation PROGMEM = {reachedFrames, PRIORITY_INFO};
+
+//"----" when a program was cancelled, followed by the height
+const Keyframe cancelledFrames[] PROGMEM = {
+  {DIGIT(0, '-'), 50}, {DIGIT(1, '-'), 50}, {DIGIT(2, '-'), 50}, {DIGIT(3, '-'), 50},
+  {SHOW(SHOW_CURRENT_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t smallO [] = {
-  SEG_C | SEG_D | SEG_E | SEG_G // o
+const Animation cancelledAnimation PROGMEM = {cancelledFrames, PRIORITY_INFO};
+
+//"Err3" when a program came to rest outside the deadband of its position, followed by the height
+const Keyframe missedFrames[] PROGMEM = {
+  {MISSED_TEXT, ANIMATION_DIGITS, SHOW_NOTHING, 1000},
+  {SHOW(SHOW_CURRENT_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t circle [] = {
-  SEG_A | SEG_B | SEG_F | SEG_G  // ° 
+const Animation missedAnimation PROGMEM = {missedFrames, PRIORITY_ERROR};
+
+//Shows the height (or "Err2") for a moment after the desk stopped
+const Keyframe heightFrames[] PROGMEM = {
+  {SHOW(SHOW_CURRENT_HEIGHT), 1500},
+  {SHOW(SHOW_CLEAR), 0}
 };
-const uint8_t empty[] = {0x0}; //blank segment for 7-Segment display
+const Animation heightAnimation PROGMEM = {heightFrames, PRIORITY_INFO};
 
-//This function debounces the initial button reads to prevent flickering
-bool debounceRead(int buttonPin, bool state)
-{
-  bool stateNow = digitalRead(buttonPin);
-  if (state != stateNow)
-  {
-    delay(10);
-    stateNow = digitalRead(buttonPin);
+#undef DIGIT
+#undef SHOW
+
+void playAnimation(const Animation* animation){
+  if (animator.play(animation)){
+    scheduler.runIn(animationTaskId, 0);
   }
-  return stateNow;
 }
 
-void animation (const uint8_t* symbol, int delayTime){
-  int digitPosition = 0;
-  while (digitPosition <  4 ){  
-    delay (delayTime);
-    display.setSegments (symbol,1,digitPosition);
-    digitPosition++;
-    if (digitPosition >= 4){
-      break;
-    }
-  };
+void stopAnimation(){
+  animator.stop();
+  scheduler.cancel(animationTaskId);
 }
 
-void showOnDisplay (const uint8_t* firstChar, const uint8_t* secondChar, const uint8_t* thirdChar, const uint8_t* fourthChar){
-  display.setSegments (firstChar,1,0);  
-  display.setSegments (secondChar,1,1);
-  display.setSegments (thirdChar,1,2);
-  display.setSegments (fourthChar,1,3);
+void animationTask(){
+  unsigned long hold = animator.step();
+  if (hold > 0){
+    scheduler.runIn(animationTaskId, hold);
+  }
 }
 
 void setup() {
   Serial.begin(9600);
-  pinMode(LED_BUILTIN, OUTPUT);
-  pinMode(BUTTON_DOWN, INPUT);
-  pinMode(BUTTON_UP, INPUT);
-  pinMode(BUTTON_POS_0, INPUT);
-  pinMode(BUTTON_POS_1, INPUT);
-  pinMode(enA, OUTPUT);
-  pinMode(in1, OUTPUT);
-  pinMode(in2, OUTPUT);
-  pinMode(enB, OUTPUT);
-  pinMode(in3, OUTPUT);
-  pinMode(in4, OUTPUT);
+#ifndef USE_ENCODERS
+  FastPin<LED_BUILTIN>::output();
+#endif
+  FastPin<BUTTON_DOWN>::input();
+  FastPin<BUTTON_UP>::input();
+  FastPin<BUTTON_POS_0>::input();
+  FastPin<BUTTON_POS_1>::input();
+  motors.begin();
+  uint8_t resetCause = readResetCause();
+  report(EVENT_BOOT, resetCause);
   readFromEEPROM();
+#ifdef USE_ENCODERS
+  encoderA.begin(encoderAChanged);
+  encoderB.begin(encoderBChanged);
+#endif
   display.setBrightness(7);
-  display.clear();
-  //Some start-up-animation on Display
-  animation (smallO, 100);
-  animation (circle, 100);
-  animation (Zero, 100);
-  animation (empty, 100);
-  display.clear();
-  delay (400);
-  // Display the saved Position 0 height on the display upon startup
-  showOnDisplay (P, empty, Zero, empty);
-  delay (1000);
-  display.showNumberDec(pos0_height, false);
-  delay (1500);
-  display.clear();
-  delay (400);
-  // Display the saved Position 1 height on the display upon startup
-  showOnDisplay (P, empty, One, empty);
-  delay (1000);
-  display.showNumberDec(pos1_height, false);
-  delay (1500);
-  display.clear();
-  delay (400);
-  // Display the current height on the display upon startup
-  checkHeight(); 
-  delay (1500);  
-  display.clear();
+  clearDisplay();
+
+  scheduler.add(motorTask, MOTOR_TICK);
+#ifdef USE_CURRENT_SENSE
+  scheduler.add(syncTask, SYNC_INTERVAL);
+#endif
+  scheduler.add(sonarTask, SONAR_INTERVAL);
+  scheduler.add(estimatorTask, ESTIMATOR_INTERVAL);
+  if (thermometer.available()) {
+    temperatureTaskId = scheduler.add(temperatureTask, TEMPERATURE_INTERVAL);
+  }
+  animationTaskId = scheduler.add(animationTask);
+  motion.begin(programFinished);
+
+  //Some start-up-animation on Display, it runs in the background so the desk can be used right away.
+  //The full one with the saved positions only when somebody plugged the desk in or pressed reset (or the cause
+  //is unknown), not when the desk reset itself in use. A power-on may set BORF too, PORF decides
+  if (resetCause == 0 || (resetCause & (RESET_POWER_ON | RESET_EXTERNAL))){
+    playAnimation(&bootAnimation);
+  }
+  else {
+    playAnimation(&quickBootAnimation);
+  }
 }
 
 void loop() {
+  PROFILE_BEGIN(STAGE_LOOP);
+  PROFILE_BEGIN(STAGE_BUTTONS);
+  debounceRead(buttonUp);
+  debounceRead(buttonDown);
+  debounceRead(buttonPos0);
+  debounceRead(buttonPos1);
+  PROFILE_END(STAGE_BUTTONS);
+
+  //Cancel a running program as soon as the up- or down-button is pressed
+  PROFILE_BEGIN(STAGE_HANDLERS);
+  handleCancel();
+
   //Handle press and hold of buttons to raise/lower, and check if enter auto-raise and auto-lower
   handleButtonUp();
   handleButtonDown();
@@ -223,6 +454,33 @@ void loop() {
   //Handle press and hold of buttons to drive into a saved position (short press) or to save the current position (long press)
   position_0();
   position_1();
+  PROFILE_END(STAGE_HANDLERS);
+
+  PROFILE_BEGIN(STAGE_SONAR);
+  readSonar();
+  PROFILE_END(STAGE_SONAR);
+
+  //Advance a running auto-drive program by one step
+  PROFILE_BEGIN(STAGE_MOTION);
+  motion.step(motionHeight(), motionVelocity());
+  PROFILE_END(STAGE_MOTION);
+
+  //Sonar polling and display sequences
+  PROFILE_BEGIN(STAGE_TASKS);
+  scheduler.run();
+  PROFILE_END(STAGE_TASKS);
+
+  //Everything above only draws into the framebuffer, the changed digits go out here in one go
+  PROFILE_BEGIN(STAGE_DISPLAY);
+  display.flush();
+  PROFILE_END(STAGE_DISPLAY);
+  PROFILE_END(STAGE_LOOP);
+
+  //Hand queued telemetry to the UART, never waits
+  telemetry.drain();
+
+  //Latency statistics on request ('p' over serial), only with -D PROFILING
+  PROFILE_POLL();
 }
 
 /***********************************************
@@ -231,110 +489,8 @@ void loop() {
   When long-pressed there is a small animation in the display and afterwards (upon release of the button) the current height is saved to eeprom and shown in the display
 ***********************************************/
 void position_0 (){
-   bool btnUpState = digitalRead(BUTTON_UP);
-   bool btnDownState = digitalRead(BUTTON_DOWN);
-   bool btnPos0State = digitalRead(BUTTON_POS_0);
-   int digitPosition = 0;
-   current_height = ultrasonic.read();
-   if (BUTTON_POS_0_STATE==LOW && debounceRead(BUTTON_POS_0, BUTTON_POS_0_STATE)){  //define what to do when the button is pressed 
-       BUTTON_POS_0_STATE=HIGH;
-       Serial.println("BUTTON Position 0 Pressed");
-       pressedTime = millis(); 
-       while (btnPos0State && debounceRead(BUTTON_POS_0, BUTTON_POS_0_STATE)){  //small animation on Display while button is held down longer than 500 ms
-         delay (400);
-         display.setSegments (smallO,1,digitPosition);
-         digitPosition++;
-         if (digitPosition >= 4){
-          delay (400);
-          showOnDisplay (Zero, Zero, Zero, Zero);
-          break;
-          }
-        }
-      }
-   else if (BUTTON_POS_0_STATE==HIGH && !debounceRead(BUTTON_POS_0, BUTTON_POS_0_STATE)){ //releasing the button checks how long it was pressed and then decides what to do
-       BUTTON_POS_0_STATE=LOW;
-       releasedTime = millis();   
-       TimePressed = releasedTime-pressedTime;
-
-       //If "Position 0 button" is long-pressed, save current height to Position 0, display "P 0" and the height in cm in the display
-       if (TimePressed >= LONG_PRESS_TIME){  
-        int pos0SaveHeight = ultrasonic.read();
-        pos1_height = savedProgram.pos1Height;
-        if (pos0SaveHeight >= pos1_height) {  //Check if Position 0 is lower than Position 1. If not, display "Err0"
-          Serial.print ("must be lower than "); 
-          Serial.println (pos1_height);
-          showOnDisplay (E, R, R, Zero);
-          delay (1000);
-          display.clear();
-        }
-        else { // Save height and give output to user
-          savedProgram.pos0Height = pos0SaveHeight;
-          EEPROM.put(EEPROM_ADDRESS, savedProgram);
-          Serial.print("Saved Position 0: ");
-          Serial.println(pos0SaveHeight);
-          showOnDisplay (P, empty, Zero, empty);
-          delay (1000);
-          display.showNumberDec(pos0SaveHeight, false);
-          delay (1000);
-          display.clear();
-        };          
-       }
-         
-       if (TimePressed < LONG_PRESS_TIME){  //If "Position 0 button" is short-pressed, check height and if possible drive to desired height
-        showOnDisplay (P, empty, Zero, empty);
-        delay (100);
-        int desired_height = pos0_height;
-        if (current_height == 0){ //Catch Sonar-Error before starting program
-          Serial.println("Won't start Down-Program because of Sonar Error.");
-        };
-        while (current_height > desired_height){
-          checkHeight();
-          Serial.print ("desired: "); Serial.println(desired_height);
-          goDown();
-          if (current_height <= desired_height && current_height != 0){ //stop automatically if the desired height is reached
-            delay (500); //a short delay to compensate for sensor inaccuracy.
-            stopMoving();
-            Serial.println("Sitting position reached");
-            showOnDisplay (P, empty, Zero, empty);
-            delay (1000);
-            checkHeight();
-            break;
-          }
-          else if (current_height == 0){  //Catch Sonar-Error while table is moving and abort program
-            Serial.println("Sonar Error in automated down-program");
-            checkHeight();
-            break;
-          }
-          if(!btnUpState && debounceRead(BUTTON_UP, btnUpState)){    //Cancel if up- or down-button is pressed during automatic procedure
-            stopMoving();
-            Serial.println("Program cancelled by user, BUTTON UP");
-            animation (Minus, 50);
-            break;
-          }
-          else if(btnUpState && !debounceRead(BUTTON_UP, btnUpState)){
-            btnUpState = LOW;
-          }
-      
-          if (!btnDownState && debounceRead(BUTTON_DOWN, btnDownState)){
-            stopMoving();
-            Serial.println("Program cancelled by user, BUTTON DOWN");
-            animation (Minus, 50);
-            break;
-          }
-          else if (btnDownState && !debounceRead(BUTTON_DOWN, btnDownState)){
-            btnDownState = LOW;
-          }
-        };
-        Serial.println("End Down-Program");
-        stopMoving();
-        delay (500);
-        checkHeight();
-        delay (1500);
-        display.clear();
-       };
-   };
-};
-
+  handlePositionButton(buttonPos0, 0);
+}
 
 /**********************************************
   Pressing the Button for Position 1 (standing)
@@ -342,127 +498,213 @@ void position_0 (){
   When long-pressed there is a small animation in the display and afterwards (upon release of the button) the current height is saved to eeprom and shown in the display
 ***********************************************/
 void position_1 (){
-   bool btnUpState = digitalRead(BUTTON_UP);
-   bool btnDownState = digitalRead(BUTTON_DOWN);
-   bool btnPos1State = digitalRead(BUTTON_POS_1);
-   int digitPosition = 0;
-   current_height = ultrasonic.read();
-    if (BUTTON_POS_1_STATE==LOW && debounceRead(BUTTON_POS_1, BUTTON_POS_1_STATE)){ //define what to do when the button is pressed 
-       BUTTON_POS_1_STATE=HIGH;
-       Serial.println("BUTTON Position 1 Pressed");
-       pressedTime = millis(); 
-       while (btnPos1State && debounceRead(BUTTON_POS_1, BUTTON_POS_1_STATE)){  //small animation on Display while button is pressed
-         delay (400);
-         display.setSegments (smallO,1,digitPosition);
-         digitPosition++;
-         if (digitPosition >= 4){
-          delay (400);
-          showOnDisplay (Zero, Zero, Zero, Zero);
-          break;
-         }
-       }
-      }
-   else if (BUTTON_POS_1_STATE==HIGH && !debounceRead(BUTTON_POS_1, BUTTON_POS_1_STATE)){ //releasing the button checks how long it was pressed and then decides what to do
-       BUTTON_POS_1_STATE=LOW;
-       releasedTime = millis();   
-       TimePressed = releasedTime-pressedTime;
-
-       //If "Position 1 button" is long-pressed, save current height to Position 1 and display "P 1" and the height in cm in the display
-       if (TimePressed >= LONG_PRESS_TIME){ 
-        int pos1SaveHeight = ultrasonic.read();
-        pos0_height = savedProgram.pos0Height;
-        if (pos1SaveHeight <= pos0_height) {  //Check if Position 1 is higher than Position 0. If not, display "Err1"
-          Serial.print ("must be higher than "); 
-          Serial.println (pos0_height);
-          showOnDisplay (E, R, R, One);
-          delay (1000);
-          display.clear();
-        }
-        else { // Save height and give output to user
-          savedProgram.pos1Height = pos1SaveHeight;
-          EEPROM.put(EEPROM_ADDRESS, savedProgram);
-          Serial.print("Saved Position 1: ");
-          Serial.println(pos1SaveHeight);
-          showOnDisplay (P, empty, One, empty);
-          delay (1000);
-          display.showNumberDec(pos1SaveHeight, false); 
-          delay (1000);
-          display.clear();
-        }        
-       }
-       
-       if (TimePressed < LONG_PRESS_TIME){ //If "Position 1 button" is short-pressed, check height and if possible drive to desired height
-        showOnDisplay (P, empty, One, empty);
-        delay (100);
-        int desired_height = pos1_height;
-        if (current_height == 0){ //Catch Sonar-Error before starting program
-          Serial.println("Won't start Up-Program because of Sonar Error.");
-        };
-        while (current_height < desired_height && current_height != 0){
-          checkHeight();
-          Serial.print ("desired: "); Serial.println(desired_height);
-          goUp();
-          if (current_height >= desired_height){ //stop automatically if the desired height is reached
-            delay (500); //a short delay to compensate for sensor inaccuracy.
-            stopMoving();
-            Serial.println("Standing position reached");
-            showOnDisplay (P, empty, One, empty);
-            delay (1000);
-            checkHeight();
-            break;
-          }
-          else if (current_height == 0){  //Catch Sonar-Error while table is moving and abort program
-            Serial.println("Sonar Error in automated up-program");
-            checkHeight();
-            break;
-          }
-          if(!btnUpState && debounceRead(BUTTON_UP, btnUpState)){    //Cancel if up- or down-button is pressed during automatic procedure
-            stopMoving();
-            Serial.println("Program cancelled by user, BUTTON UP");
-            animation (Minus, 50);
-            break;
-          }
-          else if(btnUpState && !debounceRead(BUTTON_UP, btnUpState)){
-            btnUpState = LOW;
-          }
-      
-          if (!btnDownState && debounceRead(BUTTON_DOWN, btnDownState)){
-            stopMoving();
-            Serial.println("Program cancelled by user, BUTTON DOWN");
-            animation (Minus, 50);
-            break;
-          }
-          else if (btnDownState && !debounceRead(BUTTON_DOWN, btnDownState)){
-            btnDownState = LOW;
-          }
-        };
-        Serial.println("End Up-Program");
-        stopMoving();
-        delay (500);
-        checkHeight();
-        delay (1500);
-        display.clear();
-       };
-   };
-};
+  handlePositionButton(buttonPos1, 1);
+}
+
+void handlePositionButton (Button &button, int position){
+  if (button.pressed && heldPosition < 0 && !motion.active() && manualDirection == 0){  //define what to do when the button is pressed 
+    report(EVENT_BUTTON_POSITION, position);
+    heldPosition = position;
+    pressedTime = millis();
+    playAnimation(&longPressAnimation);
+  }
+  else if (button.released && heldPosition == position){ //releasing the button checks how long it was pressed and then decides what to do
+    heldPosition = -1;
+    stopAnimation(); //the long press animation, whatever follows replaces it
+    releasedTime = millis();
+    TimePressed = releasedTime-pressedTime;
+    sequencePosition = position;
+
+    if (TimePressed >= LONG_PRESS_TIME){ //If long-pressed, save current height to the position, display "P x" and the height in cm in the display
+      savePosition(position);
+    }
+    else { //If short-pressed, check height and if possible drive to desired height
+      startProgram(position);
+    }
+  }
+}
+
+void savePosition (int position){
+  int saveHeight = current_height;
+  if (position == 0 && saveHeight >= savedProgram.pos1Height){ //Check if Position 0 is lower than Position 1. If not, display "Err0"
+    report(EVENT_SAVE_REJECTED, savedProgram.pos1Height); //must be lower than position 1
+    playAnimation(&saveErrorAnimation);
+    return;
+  }
+  if (position == 1 && saveHeight <= savedProgram.pos0Height){ //Check if Position 1 is higher than Position 0. If not, display "Err1"
+    report(EVENT_SAVE_REJECTED, savedProgram.pos0Height); //must be higher than position 0
+    playAnimation(&saveErrorAnimation);
+    return;
+  }
+
+  // Save height and give output to user
+  if (position == 0){
+    savedProgram.pos0Height = saveHeight;
+    pos0_height = saveHeight;
+  }
+  else {
+    savedProgram.pos1Height = saveHeight;
+    pos1_height = saveHeight;
+  }
+  EEPROM.put(EEPROM_ADDRESS, savedProgram);
+  report(EVENT_SAVED, saveHeight);
+  sequenceHeight = saveHeight;
+  playAnimation(&savedAnimation);
+}
+
+/****************************************
+  AUTO-DRIVE PROGRAMS
+  A short press drives to the saved height of the position, the Motion state machine does the driving.
+****************************************/
+void startProgram (int position){
+  int desired_height = position == 0 ? pos0_height : pos1_height;
+  showPosition();
+  if (current_height == 0){ //Catch Sonar-Error before starting program
+    report(EVENT_PROGRAM_REFUSED);
+    playAnimation(&heightAnimation);
+    return;
+  }
+  if (!motion.start(desired_height, motionHeight())){ //already there
+    playAnimation(&heightAnimation);
+    return;
+  }
+  report(EVENT_PROGRAM_START, desired_height);
+  stopAnimation();
+  trackHeight = true;
+}
+
+void programFinished (MotionResult result){
+  trackHeight = false;
+  if (result == MOTION_REACHED){
+    report(EVENT_PROGRAM_REACHED);
+    saveCoast();
+    playAnimation(&reachedAnimation);
+  }
+  else if (result == MOTION_CANCELLED){
+    report(EVENT_PROGRAM_CANCELLED);
+    playAnimation(&cancelledAnimation);
+  }
+  else if (result == MOTION_MISSED){ //the coast times were still learned from valid heights
+    report(EVENT_PROGRAM_MISSED, motion.target() - motionHeight());
+    saveCoast();
+    playAnimation(&missedAnimation);
+  }
+  else { //Sonar-Error while table was moving
+    report(EVENT_PROGRAM_FAILED);
+    playAnimation(&heightAnimation);
+  }
+}
+
+//Cancel if up- or down-button is pressed during automatic procedure. The press is consumed so the desk doesn't start moving manually
+void handleCancel (){
+  if (motion.active() && (buttonUp.pressed || buttonDown.pressed)){
+    report(buttonUp.pressed ? EVENT_BUTTON_UP : EVENT_BUTTON_DOWN);
+    motion.cancel();
+    buttonUp.pressed = false;
+    buttonDown.pressed = false;
+  }
+}
 
 void showHeightIfChanged() {
-  if (current_height != old_Height && current_height != 0) {  //avoid flickering of 7-segment as it now only refreshes if the value has changed
-    Serial.print("current height: "); Serial.println(current_height);
-    display.showNumberDec(current_height, false);
+  if (abs(current_height - old_Height) >= DISPLAY_STEP && current_height != 0) {  //avoid flickering of 7-segment as it now only refreshes if the value has changed
+    report(EVENT_HEIGHT, current_height);
+    showHeight(current_height);
     old_Height = current_height;
   }
 }
 
-void checkHeight() {    // Get Sensor Reading and display on 7-Segment
+void checkHeight() {    // Display the latest sensor reading on 7-Segment
   display.setBrightness(7);
-  current_height = ultrasonic.read();
   showHeightIfChanged();
   if (current_height == 0) { //display "Err2" if the sonar sensor has an error"
-    showOnDisplay (E, R, R, Two);
-    Serial.println("Sonar Sensor Error");
+    display.showText(HEIGHT_ERROR_TEXT);
+    old_Height = 0;
+    report(EVENT_SONAR_ERROR);
     };
-  delay(100); //polling frequency of the sonar sensor. Not recommended to go below 30-50 ms
+}
+
+//Starts a sonar ping every SONAR_INTERVAL, the echo is timed by interrupt while loop() carries on
+void sonarTask() {
+  //Only wait as long as an echo from where the desk can be by now takes, instead of the 20 ms default
+  ultrasonic.setMaxDistance(sonarFilter.reach(millis()));
+  ultrasonic.startPing();
+}
+
+//Keeps the speed of sound of the sonar up to date. The thermometer gets THERMOMETER_SETTLE ms between
+//selecting and reading, and is left alone while the motors run (the current sense may need the ADC)
+void temperatureTask() {
+  static bool selected = false;
+  if (motorDuty() != 0) {
+    if (selected)
+      thermometer.deselect();
+    selected = false;
+    return;
+  }
+  if (!selected) {
+    thermometer.select();
+    selected = true;
+    scheduler.runIn(temperatureTaskId, THERMOMETER_SETTLE);
+    return;
+  }
+  selected = false;
+  ultrasonic.setTemperature(thermometer.read());
+}
+
+//Picks up the result of the last ping as soon as it is there
+void readSonar() {
+  if (!ultrasonic.ready()) {
+    return;
+  }
+  unsigned int reading = ultrasonic.pollMillimetres(); //0 if the echo didn't end in time, the filter drops it
+  bool accepted = sonarFilter.add(reading, millis());
+  if (!accepted) {
+    report(EVENT_SONAR_REJECTED, reading);
+  }
+  current_height = sonarFilter.value(); //0 only once the sensor has failed for a couple of readings
+#ifdef USE_ENCODERS
+  if (accepted) { //the fusion filters itself, the median would only add delay
+    heightFusion.sonar(reading * 1000L + 500, encoderCounts()); //the reading is cut off to whole mm, +0.5 mm is the middle
+  }
+#else
+  if (accepted) { //the estimator filters itself, the median would only add delay
+    heightEstimator.update(reading * 1000L + 500, millis()); //the reading is cut off to whole mm, +0.5 mm is the middle
+  }
+#endif
+  if (motorDuty() != 0 || motion.active()) {
+    report(EVENT_SAMPLE, motionVelocity());
+  }
+  if (trackHeight) {
+    checkHeight();
+  }
+}
+
+
+#ifdef USE_ENCODERS
+//Shaft position, average of both motors (motor B turns the other way)
+long encoderCounts() {
+  return (encoderA.count() - encoderB.count()) / 2;
+}
+#endif
+
+//Moves the height estimate along with the duty the motors run at, every control tick
+void estimatorTask() {
+  heightEstimator.predict(motorDuty(), millis());
+#ifdef USE_ENCODERS
+  heightEstimator.update(heightFusion.height(encoderCounts()), millis());
+#endif
+}
+
+//Height in mm for the auto-drive programs, 0 on a sonar error
+int motionHeight() {
+  if (current_height == 0) {
+    return 0;
+  }
+  return heightEstimator.height() / 1000;
+}
+
+//Velocity in mm/s for the auto-drive programs, positive = up
+int motionVelocity() {
+  return heightEstimator.velocity() / 1000;
 }
 
 
@@ -472,133 +714,203 @@ void checkHeight() {    // Get Sensor Reading and display on 7-Segment
 //This function takes care of the events related to pressing BUTTON_UP, and only BUTTON_UP. It raises the desk when holding it
 void handleButtonUp()
 {
+  if (buttonUp.pressed && manualDirection == 0 && !motion.active() && heldPosition < 0)
+  {
+    report(EVENT_BUTTON_UP);
+    pressedTime = millis();
+    manualDirection = 1;
+    trackHeight = true;
+    stopAnimation();
+    checkHeight();
+  }
+
   //If button is held the desk raises
-  if (!BUTTON_UP_STATE && debounceRead(BUTTON_UP, BUTTON_UP_STATE))
+  if (manualDirection == 1 && buttonUp.state)
   {
-    Serial.println("BUTTON UP Pressed");
-    BUTTON_UP_STATE = HIGH;
-    long pressTime = millis();
-    long elapsed = 0;
-    while (digitalRead(BUTTON_UP))
+    //If you press down while holding UP, you indicate desire to enter program mode, stop going UP
+    if (buttonDown.state)
     {
-      elapsed = millis() - pressTime;
-      Serial.print("BUTTON UP | Holding | elapsed: ");
-      Serial.println(elapsed);
-      checkHeight();
-
-      //small delay before starting to work for smoothness
-      if (elapsed >= BUTTON_WAIT_TIME)
-      {
-        goUp();
-      }
-
-      //If you press down while holding UP, you indicate desire to enter program mode, break the loop to stop going
-      //UP, the code will catch the 2 buttons being held separately
-      if (debounceRead(BUTTON_DOWN, LOW))
+      if (motorDirection != 0)
       {
-        Serial.println("BUTTON UP | Button DOWN pressed, breaking loop");
-        break;
+        report(EVENT_BOTH_BUTTONS);
       }
+      stopMoving();
+    }
+    //small delay before starting to work for smoothness
+    else if ((long)(millis() - pressedTime) >= BUTTON_WAIT_TIME)
+    {
+      goUp();
     }
-    stopMoving();
   }
-  else if (BUTTON_UP_STATE && !debounceRead(BUTTON_UP, BUTTON_UP_STATE))
+  else if (manualDirection == 1 && buttonUp.released)
   {
-    Serial.println("BUTTON UP | Released");
-    BUTTON_UP_STATE = LOW;
-    checkHeight();
-    delay(1500);
-    display.clear();
+    report(EVENT_BUTTON_RELEASED);
+    stopMoving();
+    manualDirection = 0;
+    trackHeight = false;
+    playAnimation(&heightAnimation);
   }
 }
 
 //This function takes care of the events related to pressing BUTTON_DOWN, and only BUTTON_DOWN. It lowers the desk when holding it
 void handleButtonDown()
 {
+  if (buttonDown.pressed && manualDirection == 0 && !motion.active() && heldPosition < 0)
+  {
+    report(EVENT_BUTTON_DOWN);
+    pressedTime = millis();
+    manualDirection = -1;
+    trackHeight = true;
+    stopAnimation();
+    checkHeight();
+  }
+
   //If button is held the desk lowers
-  if (!BUTTON_DOWN_STATE && debounceRead(BUTTON_DOWN, BUTTON_DOWN_STATE))
+  if (manualDirection == -1 && buttonDown.state)
   {
-    Serial.println("BUTTON DOWN | Pressed");
-    BUTTON_DOWN_STATE = HIGH;
-    long pressTime = millis();
-    long elapsed = 0;
-    while (digitalRead(BUTTON_DOWN))
+    //If you press UP while holding DOWN, you indicate desire to enter program mode, stop going DOWN
+    if (buttonUp.state)
     {
-      elapsed = millis() - pressTime;
-      Serial.print("BUTTON DOWN | Holding | elapsed: ");
-      Serial.println(elapsed);
-      checkHeight();
-
-      //small delay before starting to work for smoothness
-      if (elapsed >= BUTTON_WAIT_TIME) 
+      if (motorDirection != 0)
       {
-        goDown();
-      }
-
-      //If you press UP while holding DOWN, you indicate desire to enter program mode, break the loop to stop going
-      //DOWN, the code will catch the 2 buttons being held separately
-      if (debounceRead(BUTTON_UP, LOW))
-      {
-        Serial.println("BUTTON DOWN | Button UP pressed, breaking loop");
-        break;
+        report(EVENT_BOTH_BUTTONS);
       }
+      stopMoving();
+    }
+    //small delay before starting to work for smoothness
+    else if ((long)(millis() - pressedTime) >= BUTTON_WAIT_TIME)
+    {
+      goDown();
     }
-    stopMoving();
   }
-  else if (BUTTON_DOWN_STATE && !debounceRead(BUTTON_DOWN, BUTTON_DOWN_STATE))
+  else if (manualDirection == -1 && buttonDown.released)
   {
-    Serial.println("BUTTON DOWN | Released");
-    BUTTON_DOWN_STATE = LOW;
-    checkHeight();
-    delay(1500);
-    display.clear();
+    report(EVENT_BUTTON_RELEASED);
+    stopMoving();
+    manualDirection = 0;
+    trackHeight = false;
+    playAnimation(&heightAnimation);
   }
 }
 
 
 /****************************************
   LOWER / RAISE DESK FUNCTIONS
+  goUp(), goDown() and stopMoving() only set the duty the motors should run at. motorTask() ramps the
+  duty actually applied to enA/enB towards it every MOTOR_TICK ms (see MotionProfile.h).
 ****************************************/
-//Send PWM signal to L298N enX pin (sets motor speed)
-void goUp()
+//Called every loop while moving, only the first call of a new direction is reported
+void goUp(int pwm)
 {
-  Serial.print("UP:"); Serial.println(PWM_SPEED_UP);
-  digitalWrite(LED_BUILTIN, HIGH);
+  if (motorDirection != 1)
+  {
+    report(EVENT_MOTOR_UP, pwm);
+  }
+  motorDirection = 1;
+  motorPwm = pwm;
+  motorProfile.setTarget(pwm);
+}
 
-  //Motor A: Turns in (LH) direction
-  analogWrite(enA, PWM_SPEED_UP);
-  digitalWrite(in1, LOW);
-  digitalWrite(in2, HIGH);
+//Called every loop while moving, only the first call of a new direction is reported
+void goDown(int pwm)
+{
+  if (motorDirection != -1)
+  {
+    report(EVENT_MOTOR_DOWN, pwm);
+  }
+  motorDirection = -1;
+  motorPwm = pwm;
+  motorProfile.setTarget(-pwm);
+}
 
-  //Motor B: Turns in OPPOSITE (HL) direction
-  analogWrite(enB, PWM_SPEED_UP);
-  digitalWrite(in4, HIGH);
-  digitalWrite(in3, LOW);
+//Ramps the motors down
+void stopMoving()
+{
+  bool wasMoving = motorDirection != 0;
+  motorDirection = 0;
+  motorPwm = 0;
+  motorProfile.setTarget(0);
+  if (wasMoving)
+  {
+    report(EVENT_MOTOR_STOP);
+  }
 }
 
-//Send PWM signal to L298N enX pin (sets motor speed)
-void goDown()
+//Motors off at once, without ramp. For errors
+void haltMotors()
 {
-  Serial.print("DOWN:");Serial.println(PWM_SPEED_DOWN);
-  digitalWrite(LED_BUILTIN, HIGH);
-  
-  //Motor A: Turns in (HL) Direction
-  analogWrite(enA, PWM_SPEED_DOWN);
-  digitalWrite(in1, HIGH);
-  digitalWrite(in2, LOW);
+  stopMoving();
+  motorProfile.halt();
+  applyDuty(0);
+}
 
-  //Motor B: Turns in OPPOSITE (LH) direction
-  analogWrite(enB, PWM_SPEED_DOWN);
-  digitalWrite(in4, LOW);
-  digitalWrite(in3, HIGH);
+//Duty currently applied to the motors, positive = up
+int motorDuty()
+{
+  return motorProfile.output();
 }
 
-void stopMoving()
+void motorTask()
 {
-  analogWrite(enA, 0);
-  analogWrite(enB, 0);
-  digitalWrite(LED_BUILTIN, LOW);
-  Serial.println("Idle...");
+  if (motorProfile.settled())
+  {
+    return;
+  }
+  applyDuty(motorProfile.update(MOTOR_TICK));
+}
+
+#ifdef USE_CURRENT_SENSE
+//Shares the load between the motors while they run (see MotorSync.h)
+void syncTask()
+{
+  if (motorDuty() == 0)
+  {
+    motorSync.reset();
+    return;
+  }
+  motorSync.update(analogRead(CURRENT_SENSE_A), analogRead(CURRENT_SENSE_B));
+  applyDuty(motorDuty());
+}
+#endif
+
+//Writes a signed duty to the L298N, see L298NDriver.h for how the direction changes
+void applyDuty(int duty)
+{
+  static int lastDutyA = 0;
+  static int lastDutyB = 0;
+  int dutyA = duty;
+  int dutyB = duty;
+#ifdef USE_CURRENT_SENSE
+  motorSync.split(duty, dutyA, dutyB);
+#endif
+  if (dutyA == lastDutyA && dutyB == lastDutyB)
+  {
+    return;
+  }
+  motors.drive(dutyA, dutyB);
+#ifndef USE_ENCODERS
+  FastPin<LED_BUILTIN>::write(duty != 0); //pin 13 is an encoder input otherwise
+#endif
+  lastDutyA = dutyA;
+  lastDutyB = dutyB;
+}
+
+/****************************************
+  TELEMETRY
+  Every event is sent as a binary frame together with a snapshot of the desk (see Telemetry.h),
+  tools/telemetry.py turns the frames back into readable lines.
+****************************************/
+void report(TelemetryEvent event, int value)
+{
+  uint8_t flags = 0;
+  if (buttonUp.state) flags |= TELEMETRY_FLAG_BUTTON_UP;
+  if (buttonDown.state) flags |= TELEMETRY_FLAG_BUTTON_DOWN;
+  if (buttonPos0.state) flags |= TELEMETRY_FLAG_BUTTON_POS_0;
+  if (buttonPos1.state) flags |= TELEMETRY_FLAG_BUTTON_POS_1;
+  if (trackHeight) flags |= TELEMETRY_FLAG_TRACKING;
+  if (manualDirection != 0) flags |= TELEMETRY_FLAG_MANUAL;
+  if (sequencePosition == 1) flags |= TELEMETRY_FLAG_POSITION_1;
+  telemetry.send(event, millis(), current_height, motorDuty(), motion.state(), flags, value);
 }
 
 /****************************************
@@ -606,15 +918,38 @@ void stopMoving()
 ****************************************/
 void readFromEEPROM()
 {
-  Serial.println("Reading from EEPROM");
   EEPROM.get(EEPROM_ADDRESS, savedProgram);
-  Serial.print("Position 0: ");
-  Serial.print(savedProgram.pos0Height);
+  //Saved by an older firmware in whole cm
+  if (savedProgram.pos0Height > 0 && savedProgram.pos0Height < SONAR_MIN_HEIGHT)
+    savedProgram.pos0Height *= 10;
+  if (savedProgram.pos1Height > 0 && savedProgram.pos1Height < SONAR_MIN_HEIGHT)
+    savedProgram.pos1Height *= 10;
   pos0_height = savedProgram.pos0Height;
-  Serial.print("cm | Position 1: ");
-  Serial.print(savedProgram.pos1Height);
-  Serial.println("cm");
   pos1_height = savedProgram.pos1Height;
+  report(EVENT_POSITION_0_LOADED, pos0_height);
+  report(EVENT_POSITION_1_LOADED, pos1_height);
+
+  EEPROM.get(COAST_EEPROM_ADDRESS, savedCoast);
+  if (savedCoast.version != STORED_COAST_VERSION) { //never learned, keep the defaults of Motion
+    savedCoast = StoredCoast();
+    savedCoast.upTime = motion.coastTime(1);
+    savedCoast.downTime = motion.coastTime(-1);
+  }
+  motion.setCoastTime(1, savedCoast.upTime);
+  motion.setCoastTime(-1, savedCoast.downTime);
+}
+
+//Persists the coast times Motion learned, only if they changed noticeably to spare the EEPROM
+void saveCoast()
+{
+  int upTime = motion.coastTime(1);
+  int downTime = motion.coastTime(-1);
+  if (abs(upTime - savedCoast.upTime) < COAST_SAVE_CHANGE && abs(downTime - savedCoast.downTime) < COAST_SAVE_CHANGE)
+    return;
+  savedCoast.upTime = upTime;
+  savedCoast.downTime = downTime;
+  EEPROM.put(COAST_EEPROM_ADDRESS, savedCoast);
+  report(EVENT_COAST_SAVED, motion.direction() > 0 ? upTime : -downTime);
 }
 
 void clearEEPROM(){
@@ -622,4 +957,4 @@ void clearEEPROM(){
   for (int i = 0; i < eeprom_length; i++) {
     EEPROM.write(i, 0);
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,24 @@
+/*
+  MotorStub.h
+
+  The motor functions of main.cpp (see Motor.h) for the unit tests. src/ is linked into every test
+  program, main.cpp is not, so Motion.cpp needs them even where a test doesn't drive anything.
+  The duty jumps to what was asked for, there is no ramp. Include it in one file per test program.
+*/
+#ifndef MotorStub_h
+#define MotorStub_h
+
+#include "Motor.h"
+
+const int PWM_SPEED_UP = 1023;
+const int PWM_SPEED_DOWN = 883;
+
+int stubDuty = 0; //positive = up
+
+void goUp(int pwm) { stubDuty = pwm; }
+void goDown(int pwm) { stubDuty = -pwm; }
+void stopMoving() { stubDuty = 0; }
+void haltMotors() { stubDuty = 0; }
+int motorDuty() { return stubDuty; }
+
+#endif // MotorStub_h
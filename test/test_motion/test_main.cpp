@@ -0,0 +1,135 @@
+/*
+  Motion: the stop-ahead by the coast model, learning the coast times and how a program ends.
+  pio test -e native_test
+*/
+#include <unity.h>
+#include <ArduinoNative.h>
+#include "Motion.h"
+#include "../MotorStub.h"
+
+#define SETTLED_US 600000UL        //longer than SETTLE_TIME of Motion.cpp
+#define APPROACH_TIMED_OUT_US 10001000UL //longer than APPROACH_TIMEOUT
+
+Motion motion;
+MotionResult result;
+int results;
+
+static void finished(MotionResult finishedWith) {
+  result = finishedWith;
+  results++;
+}
+
+void setUp() {
+  motion = Motion();
+  motion.begin(finished);
+  results = 0;
+  stubDuty = 0;
+}
+
+void tearDown() {
+}
+
+//Starts a program and steps it into the height controller, height is within its approach distance
+static void approach(int target, int height, int speed) {
+  TEST_ASSERT_TRUE(motion.start(target, height));
+  motion.step(height, speed);
+  TEST_ASSERT_EQUAL(MOTION_APPROACH, motion.state());
+}
+
+//Faster than an int8_t holds: the coast time of the direction is used, whatever the speed
+void test_stop_ahead_uses_the_coast_time_of_the_direction() {
+  motion.setCoastTime(1, 200);
+  motion.setCoastTime(-1, 0);
+  approach(1000, 960, 150);
+  motion.step(970, 150); //coasts 150 mm/s * 200 ms = 30 mm, right to the target
+  TEST_ASSERT_EQUAL(MOTION_SETTLE, motion.state());
+  TEST_ASSERT_EQUAL_INT(0, motorDuty());
+}
+
+void test_stop_ahead_uses_the_coast_time_of_the_direction_down() {
+  motion.setCoastTime(1, 0);
+  motion.setCoastTime(-1, 200);
+  approach(1000, 1040, -150);
+  motion.step(1030, -150);
+  TEST_ASSERT_EQUAL(MOTION_SETTLE, motion.state());
+}
+
+void test_keeps_going_while_the_coast_falls_short() {
+  motion.setCoastTime(1, 100);
+  approach(1000, 960, 150);
+  motion.step(970, 150); //only 15 mm of coast
+  TEST_ASSERT_EQUAL(MOTION_APPROACH, motion.state());
+  TEST_ASSERT_TRUE(motorDuty() > 0);
+}
+
+//Stopped at 970 mm at 150 mm/s, came to rest at 1003: 220 ms of coast, the model moves a quarter of the way
+void test_coast_time_is_learned_from_where_the_desk_came_to_rest() {
+  motion.setCoastTime(1, 200);
+  approach(1000, 960, 150);
+  motion.step(970, 150);
+  hal::advance(SETTLED_US);
+  motion.step(1003, 0);
+  TEST_ASSERT_EQUAL(MOTION_IDLE, motion.state());
+  TEST_ASSERT_EQUAL_INT(1, results);
+  TEST_ASSERT_EQUAL(MOTION_REACHED, result);
+  TEST_ASSERT_EQUAL_INT(205, motion.coastTime(1));
+  TEST_ASSERT_EQUAL_INT(150, motion.coastTime(-1));
+}
+
+//A sonar error once the desk is at rest: nothing to learn from or correct by, the program failed
+void test_sonar_error_while_settling_learns_nothing() {
+  motion.setCoastTime(-1, 200);
+  approach(1000, 1040, -150);
+  motion.step(1030, -150);
+  TEST_ASSERT_EQUAL(MOTION_SETTLE, motion.state());
+  hal::advance(SETTLED_US);
+  motion.step(0, 0);
+  motion.step(0, 0);
+  TEST_ASSERT_EQUAL(MOTION_IDLE, motion.state());
+  TEST_ASSERT_EQUAL_INT(1, results);
+  TEST_ASSERT_EQUAL(MOTION_FAILED, result);
+  TEST_ASSERT_EQUAL_INT(200, motion.coastTime(-1));
+}
+
+void test_sonar_error_while_driving_fails() {
+  TEST_ASSERT_TRUE(motion.start(1000, 700));
+  motion.step(700, 0);
+  motion.step(0, 0);
+  TEST_ASSERT_EQUAL_INT(0, motorDuty());
+  motion.step(0, 0);
+  TEST_ASSERT_EQUAL(MOTION_IDLE, motion.state());
+  TEST_ASSERT_EQUAL(MOTION_FAILED, result);
+}
+
+//The controller gave up outside the deadband: that is no reach
+void test_approach_timeout_outside_the_deadband_is_missed() {
+  approach(1000, 960, 0);
+  hal::advance(APPROACH_TIMED_OUT_US);
+  motion.step(960, 0);
+  TEST_ASSERT_EQUAL(MOTION_SETTLE, motion.state());
+  hal::advance(SETTLED_US);
+  motion.step(960, 0);
+  TEST_ASSERT_EQUAL(MOTION_IDLE, motion.state());
+  TEST_ASSERT_EQUAL_INT(1, results);
+  TEST_ASSERT_EQUAL(MOTION_MISSED, result);
+}
+
+void test_coast_times_are_limited() {
+  motion.setCoastTime(1, 5000);
+  motion.setCoastTime(-1, -10);
+  TEST_ASSERT_EQUAL_INT(1000, motion.coastTime(1));
+  TEST_ASSERT_EQUAL_INT(0, motion.coastTime(-1));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stop_ahead_uses_the_coast_time_of_the_direction);
+  RUN_TEST(test_stop_ahead_uses_the_coast_time_of_the_direction_down);
+  RUN_TEST(test_keeps_going_while_the_coast_falls_short);
+  RUN_TEST(test_coast_time_is_learned_from_where_the_desk_came_to_rest);
+  RUN_TEST(test_sonar_error_while_settling_learns_nothing);
+  RUN_TEST(test_sonar_error_while_driving_fails);
+  RUN_TEST(test_approach_timeout_outside_the_deadband_is_missed);
+  RUN_TEST(test_coast_times_are_limited);
+  return UNITY_END();
+}
@@ -0,0 +1,160 @@
+/*
+  Sonar path: the asynchronous pings of the Ultrasonic library and the SonarFilter behind them.
+  pio test -e native_test
+*/
+#include <unity.h>
+#include <ArduinoNative.h>
+#include <Ultrasonic.h>
+#include "SonarFilter.h"
+#include "../MotorStub.h"
+
+#define TRIG 4
+#define ECHO 5
+
+//The limits of main.cpp: 400 - 1600 mm, 60 mm/s, 20 mm of noise
+#define MIN_HEIGHT 400
+#define MAX_HEIGHT 1600
+#define MAX_SPEED 60
+#define MARGIN 20
+
+Ultrasonic sonar(TRIG, ECHO);
+
+void setUp() {
+  hal::setInput(ECHO, LOW);
+  sonar.setTemperature(REFERENCE_TEMPERATURE);
+}
+
+void tearDown() {
+}
+
+//Pings and lets the echo pin go high after a while, LOW again after echoUs (0: it stays high)
+static void ping(unsigned long echoUs) {
+  sonar.startPing();
+  hal::advance(450);
+  hal::setInput(ECHO, HIGH);
+  if (echoUs > 0) {
+    hal::advance(echoUs);
+    hal::setInput(ECHO, LOW);
+  }
+}
+
+void test_echo_within_reach_is_measured() {
+  sonar.setMaxDistance(MAX_HEIGHT);
+  ping(5830);
+  TEST_ASSERT_TRUE(sonar.ready());
+  TEST_ASSERT_UINT_WITHIN(2, sonar.toMillimetres(5830), sonar.pollMillimetres());
+}
+
+void test_ping_without_echo_reads_zero() {
+  sonar.setMaxDistance(1000);
+  sonar.startPing();
+  hal::advance(20000);
+  TEST_ASSERT_TRUE(sonar.ready());
+  TEST_ASSERT_EQUAL_UINT(0, sonar.pollMillimetres());
+}
+
+//The HC-SR04 holds the echo pin high for ~38 ms when nothing comes back. Whatever the reach and the
+//temperature, that must not come out as a distance just inside the reach
+void test_echo_that_doesnt_end_reads_zero() {
+  const int temperatures[] = {50, 200, 350};
+  for (int temperature : temperatures) {
+    sonar.setTemperature(temperature);
+    for (unsigned int reach = MIN_HEIGHT; reach <= MAX_HEIGHT; reach += 100) {
+      sonar.setMaxDistance(reach);
+      ping(0);
+      hal::advance(38000);
+      TEST_ASSERT_TRUE(sonar.ready());
+      TEST_ASSERT_EQUAL_UINT(0, sonar.pollMillimetres());
+      hal::setInput(ECHO, LOW);
+    }
+  }
+}
+
+void test_filter_accepts_first_reading() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  TEST_ASSERT_EQUAL_UINT(0, filter.value());
+  TEST_ASSERT_TRUE(filter.add(1000, 0));
+  TEST_ASSERT_EQUAL_UINT(1000, filter.value());
+}
+
+void test_filter_rejects_readings_out_of_range() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  TEST_ASSERT_FALSE(filter.add(0, 0));
+  TEST_ASSERT_FALSE(filter.add(MIN_HEIGHT - 1, 50));
+  TEST_ASSERT_FALSE(filter.add(MAX_HEIGHT + 1, 100));
+  TEST_ASSERT_TRUE(filter.add(MIN_HEIGHT, 150));
+}
+
+//50 ms after a reading the desk can be MARGIN + 3 mm away from it
+void test_filter_rejects_jumps_the_desk_cant_make() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  filter.add(1000, 0);
+  TEST_ASSERT_FALSE(filter.add(1024, 50));
+  TEST_ASSERT_TRUE(filter.add(1023, 50));
+}
+
+//A spurious echo that slipped through doesn't move the reference: 1040 is close enough to the last
+//reading, but not to the median
+void test_filter_compares_with_the_median() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  filter.add(1000, 0);
+  filter.add(1000, 50);
+  filter.add(1020, 100);
+  TEST_ASSERT_FALSE(filter.add(1040, 150));
+  TEST_ASSERT_TRUE(filter.add(1010, 200));
+}
+
+void test_filter_fails_after_bad_readings_and_recovers() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  unsigned long now = 0;
+  filter.add(1000, now);
+  for (uint8_t i = 0; i < SONAR_ERROR_ENTER; i++)
+    filter.add(0, now += 50);
+  TEST_ASSERT_TRUE(filter.failed());
+  TEST_ASSERT_EQUAL_UINT(0, filter.value());
+
+  for (uint8_t i = 0; i < SONAR_ERROR_LEAVE - 1; i++)
+    TEST_ASSERT_FALSE(filter.add(900, now += 50));
+  TEST_ASSERT_TRUE(filter.add(900, now += 50));
+  TEST_ASSERT_FALSE(filter.failed());
+  TEST_ASSERT_EQUAL_UINT(900, filter.value());
+}
+
+void test_reach_is_max_without_readings() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  TEST_ASSERT_EQUAL_UINT(MAX_HEIGHT, filter.reach(0));
+}
+
+void test_reach_grows_with_the_time_since_the_last_reading() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  filter.add(1000, 0);
+  TEST_ASSERT_EQUAL_UINT(1000 + MARGIN, filter.reach(0));
+  TEST_ASSERT_EQUAL_UINT(1000 + MARGIN + MAX_SPEED, filter.reach(1000));
+  TEST_ASSERT_EQUAL_UINT(MAX_HEIGHT, filter.reach(60000));
+}
+
+//The farthest reading the filter accepts is the reach, one further is rejected
+void test_reach_matches_what_the_filter_accepts() {
+  SonarFilter filter(MIN_HEIGHT, MAX_HEIGHT, MAX_SPEED, MARGIN);
+  filter.add(1000, 0);
+  unsigned int reach = filter.reach(500);
+  SonarFilter other = filter;
+  TEST_ASSERT_FALSE(other.add(reach + 1, 500));
+  TEST_ASSERT_TRUE(filter.add(reach, 500));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_echo_within_reach_is_measured);
+  RUN_TEST(test_ping_without_echo_reads_zero);
+  RUN_TEST(test_echo_that_doesnt_end_reads_zero);
+  RUN_TEST(test_filter_accepts_first_reading);
+  RUN_TEST(test_filter_rejects_readings_out_of_range);
+  RUN_TEST(test_filter_rejects_jumps_the_desk_cant_make);
+  RUN_TEST(test_filter_compares_with_the_median);
+  RUN_TEST(test_filter_fails_after_bad_readings_and_recovers);
+  RUN_TEST(test_reach_is_max_without_readings);
+  RUN_TEST(test_reach_grows_with_the_time_since_the_last_reading);
+  RUN_TEST(test_reach_matches_what_the_filter_accepts);
+  return UNITY_END();
+}
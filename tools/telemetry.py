@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Decodes the binary telemetry of the desk controller (see include/Telemetry.h) into readable lines.
+
+  python3 tools/telemetry.py COM3                 # live from the Arduino (needs pyserial)
+  python3 tools/telemetry.py /dev/ttyACM0 --csv   # one CSV line per frame
+  .pio/build/native/program | python3 tools/telemetry.py -
+
+Bytes that are not part of a valid frame are passed through as text. Firmware built with PROFILING
+sends no frames, only the profiler table.
+"""
+import argparse
+import os
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+FRAME_SIZE = 16
+BODY = struct.Struct("<BIhhBBh")  # event, millis, height, pwm, state, flags, value
+
+# (name, value shown) per TelemetryEvent in include/Telemetry.h, keep in sync
+EVENTS = [
+    ("sample, mm/s", True),
+    ("boot, reset cause", True),
+    ("position 0 loaded", True),
+    ("position 1 loaded", True),
+    ("button up", False),
+    ("button down", False),
+    ("button position", True),
+    ("button released", False),
+    ("up and down held, stopping", False),
+    ("motor up", True),
+    ("motor down", True),
+    ("motor stop", False),
+    ("height", True),
+    ("sonar error", False),
+    ("saved", True),
+    ("save rejected", True),
+    ("program start", True),
+    ("program refused, sonar error", False),
+    ("program reached", False),
+    ("program cancelled", False),
+    ("program failed, sonar error", False),
+    ("sonar reading rejected", True),
+    ("coast time saved, ms", True),
+    ("program missed target, mm to go", True),
+]
+
+# MotionState in include/Motion.h
+STATES = ["idle", "ramp-up", "cruise", "approach", "settle", "fault"]
+
+FLAGS = ["up", "down", "p0", "p1", "track", "manual", "pos1", "DROPPED"]
+
+
+def frames(stream, text):
+    """Yields decoded frames, hands everything else to text()"""
+    data = b""
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            text(data)
+            return
+        data += chunk
+        while True:
+            start = data.find(SYNC)
+            if start < 0:
+                keep = 1 if data.endswith(SYNC[:1]) else 0  # may be the first half of a sync
+                text(data[:len(data) - keep])
+                data = data[len(data) - keep:]
+                break
+            if start > 0:
+                text(data[:start])
+                data = data[start:]
+            if len(data) < FRAME_SIZE:
+                break
+            if sum(data[2:15]) & 0xFF != data[15]:
+                text(data[:1])
+                data = data[1:]
+                continue
+            body = BODY.unpack(data[2:15])
+            data = data[FRAME_SIZE:]
+            yield body
+
+
+def describe(event, millis, height, pwm, state, flags, value):
+    name, with_value = EVENTS[event] if event < len(EVENTS) else ("event %d" % event, True)
+    if with_value:
+        name += " %d" % value
+    state_name = STATES[state] if state < len(STATES) else str(state)
+    flag_names = " ".join(f for bit, f in enumerate(FLAGS) if flags & (1 << bit))
+    height_text = "%5.1f cm" % (height / 10.0) if height else "   err  "
+    return "%9.3f s  %s  pwm %+5d  %-8s  %-28s %s" % (millis / 1000.0, height_text, pwm, state_name, name, flag_names)
+
+
+def open_input(name, baud):
+    if name == "-":
+        return sys.stdin.buffer
+    if os.path.isfile(name):
+        return open(name, "rb", buffering=0)
+    import serial  # pyserial, only needed for a live connection
+    return serial.Serial(name, baud)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the desk controller's serial telemetry")
+    parser.add_argument("input", help="serial port, file or - for stdin")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--csv", action="store_true", help="print frames as CSV")
+    args = parser.parse_args()
+
+    def text(data):
+        if data and not args.csv:
+            sys.stdout.write(data.decode("ascii", "replace"))
+            sys.stdout.flush()
+
+    if args.csv:
+        print("millis,event,height,pwm,state,flags,value")
+    stream = open_input(args.input, args.baud)
+    try:
+        for event, millis, height, pwm, state, flags, value in frames(stream, text):
+            if args.csv:
+                print("%d,%d,%d,%d,%d,%d,%d" % (millis, event, height, pwm, state, flags, value))
+            else:
+                print(describe(event, millis, height, pwm, state, flags, value))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()